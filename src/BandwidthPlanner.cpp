@@ -0,0 +1,152 @@
+#include <dvl_teledyne/BandwidthPlanner.hpp>
+#include <dvl_teledyne/PD0Raw.hpp>
+#include <stdexcept>
+
+using namespace dvl_teledyne;
+
+namespace
+{
+    /** Bits on the wire per byte for a 8N1 serial line */
+    static const int BITS_PER_BYTE = 10;
+    /** Reserved bytes that precede the checksum at the end of each PD0
+     * ensemble
+     */
+    static const size_t PD0_RESERVED_SIZE = 2;
+    static const size_t PD0_CHECKSUM_SIZE = 2;
+    /** Upper bound on the size of a PD6 ensemble (eleven lines) */
+    static const size_t PD6_MAX_ENSEMBLE_SIZE = 11 * 60;
+
+    void validateBaudrate(int baudrate)
+    {
+        if (baudrate <= 0)
+            throw std::invalid_argument("BandwidthPlanner: the baud rate must be positive");
+    }
+}
+
+DataSelection::DataSelection()
+    : velocity(true)
+    , correlation(true)
+    , intensity(true)
+    , quality(true)
+    , bottom_tracking(true)
+{
+}
+
+std::string DataSelection::toCommand() const
+{
+    std::string cmd = "WD";
+    cmd += velocity ? '1' : '0';
+    cmd += correlation ? '1' : '0';
+    cmd += intensity ? '1' : '0';
+    cmd += quality ? '1' : '0';
+    cmd += "00000";
+    return cmd;
+}
+
+size_t BandwidthPlanner::computeEnsembleSize(DataSelection const& selection, int cell_count)
+{
+    int msg_count = 2;
+    size_t size = sizeof(raw::FixedLeader) + sizeof(raw::VariableLeader);
+    if (selection.velocity)
+    {
+        msg_count++;
+        size += sizeof(raw::VelocityMessage) + cell_count * sizeof(raw::CellVelocity);
+    }
+    if (selection.correlation)
+    {
+        msg_count++;
+        size += sizeof(raw::CorrelationMessage) + cell_count * sizeof(raw::CellCorrelation);
+    }
+    if (selection.intensity)
+    {
+        msg_count++;
+        size += sizeof(raw::IntensityMessage) + cell_count * sizeof(raw::CellIntensity);
+    }
+    if (selection.quality)
+    {
+        msg_count++;
+        size += sizeof(raw::QualityMessage) + cell_count * sizeof(raw::CellQuality);
+    }
+    if (selection.bottom_tracking)
+    {
+        msg_count++;
+        size += sizeof(raw::BottomTrackingMessage);
+    }
+    return sizeof(raw::Header) + 2 * msg_count + size + PD0_RESERVED_SIZE + PD0_CHECKSUM_SIZE;
+}
+
+size_t BandwidthPlanner::computeEnsembleSize(OUTPUT_FORMATS format, DataSelection const& selection, int cell_count)
+{
+    switch(format)
+    {
+    case FORMAT_PD4: return PD4_ENSEMBLE_SIZE;
+    case FORMAT_PD5: return PD5_ENSEMBLE_SIZE;
+    case FORMAT_PD6: return PD6_MAX_ENSEMBLE_SIZE;
+    default: return computeEnsembleSize(selection, cell_count);
+    }
+}
+
+base::Time BandwidthPlanner::computeWireTime(size_t size, int baudrate)
+{
+    validateBaudrate(baudrate);
+    return base::Time::fromMicroseconds(static_cast<int64_t>(size) * BITS_PER_BYTE * 1000000 / baudrate);
+}
+
+BandwidthPlan BandwidthPlanner::evaluate(DataSelection const& selection, int cell_count,
+        int baudrate, float ensemble_rate, base::Time const& latency_budget)
+{
+    validateBaudrate(baudrate);
+
+    BandwidthPlan plan;
+    plan.selection  = selection;
+    plan.cell_count = cell_count;
+    plan.ensemble_size = computeEnsembleSize(selection, cell_count);
+    plan.wire_time  = computeWireTime(plan.ensemble_size, baudrate);
+    plan.max_ensemble_rate = static_cast<float>(baudrate) / BITS_PER_BYTE / plan.ensemble_size;
+
+    plan.feasible = (ensemble_rate <= plan.max_ensemble_rate);
+    if (!latency_budget.isNull() && plan.wire_time > latency_budget)
+        plan.feasible = false;
+    return plan;
+}
+
+BandwidthPlan BandwidthPlanner::propose(DataSelection const& desired, int cell_count,
+        int baudrate, float ensemble_rate, base::Time const& latency_budget)
+{
+    BandwidthPlan plan = evaluate(desired, cell_count, baudrate, ensemble_rate, latency_budget);
+    if (plan.feasible)
+        return plan;
+
+    // Remove the per-cell messages that are the least useful for navigation
+    DataSelection selection = desired;
+    bool* optional[3] = { &selection.quality, &selection.intensity, &selection.correlation };
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!*optional[i])
+            continue;
+        *optional[i] = false;
+        plan = evaluate(selection, cell_count, baudrate, ensemble_rate, latency_budget);
+        if (plan.feasible)
+            return plan;
+    }
+
+    // Find the biggest cell count that fits. The ensemble size is monotonic
+    // in the cell count
+    if (selection.velocity)
+    {
+        int low = 0, high = cell_count - 1;
+        while (low < high)
+        {
+            int middle = (low + high + 1) / 2;
+            if (evaluate(selection, middle, baudrate, ensemble_rate, latency_budget).feasible)
+                low = middle;
+            else
+                high = middle - 1;
+        }
+        if (low > 0)
+            return evaluate(selection, low, baudrate, ensemble_rate, latency_budget);
+    }
+
+    selection.velocity = false;
+    return evaluate(selection, 0, baudrate, ensemble_rate, latency_budget);
+}
@@ -0,0 +1,103 @@
+#ifndef DVL_TELEDYNE_BANDWIDTHPLANNER_HPP
+#define DVL_TELEDYNE_BANDWIDTHPLANNER_HPP
+
+#include <dvl_teledyne/CompactFormats.hpp>
+#include <string>
+
+namespace dvl_teledyne
+{
+    /** Set of optional messages in PD0 ensembles
+     *
+     * The fixed and variable leaders are always sent
+     */
+    struct DataSelection
+    {
+        /** Per-cell messages, see the WD command */
+        bool velocity;
+        bool correlation;
+        bool intensity;
+        bool quality;
+        /** Bottom tracking message. It is not sent if bottom tracking is
+         * disabled (BP0)
+         */
+        bool bottom_tracking;
+
+        /** Selects all messages */
+        DataSelection();
+
+        /** Returns the WD command that selects the per-cell messages, e.g.
+         * "WD111100000"
+         */
+        std::string toCommand() const;
+    };
+
+    /** Size of an ensemble and time needed to transmit it */
+    struct BandwidthPlan
+    {
+        DataSelection selection;
+        int cell_count;
+        /** Size of one ensemble in bytes, including the checksum */
+        size_t ensemble_size;
+        /** Time needed to transmit one ensemble on the serial line */
+        base::Time wire_time;
+        /** Maximum count of ensembles per second the serial line can carry */
+        float max_ensemble_rate;
+        /** Whether this plan meets the requested rate and latency budget */
+        bool feasible;
+    };
+
+    /** Computes ensemble sizes and serial line usage, and proposes
+     * configurations that fit a given link
+     *
+     * Serial lines are assumed to be 8N1, i.e. 10 bits on the wire per
+     * byte
+     */
+    class BandwidthPlanner
+    {
+    public:
+        /** Exact size in bytes of a PD0 ensemble with the given selection and
+         * count of depth cells, including header and checksum
+         */
+        static size_t computeEnsembleSize(DataSelection const& selection, int cell_count);
+
+        /** Size in bytes of an ensemble in the given format. The PD6 size is
+         * an upper bound, as the lines have variable length
+         */
+        static size_t computeEnsembleSize(OUTPUT_FORMATS format, DataSelection const& selection, int cell_count);
+
+        /** Time needed to transmit \c size bytes at \c baudrate
+         *
+         * Throws std::invalid_argument if \c baudrate is not positive
+         */
+        static base::Time computeWireTime(size_t size, int baudrate);
+
+        /** Evaluates a PD0 configuration
+         *
+         * The plan is feasible if one ensemble can be transmitted within both
+         * the period 1 / \c ensemble_rate and \c latency_budget. Set
+         * \c latency_budget to null to only check the rate
+         *
+         * Throws std::invalid_argument if \c baudrate is not positive
+         */
+        static BandwidthPlan evaluate(DataSelection const& selection, int cell_count,
+                int baudrate, float ensemble_rate, base::Time const& latency_budget = base::Time());
+
+        /** Proposes a PD0 configuration derived from the desired one that fits
+         * the link
+         *
+         * If the desired configuration does not fit, the per-cell messages
+         * are removed in the order quality, intensity and correlation, then
+         * the cell count is reduced, and finally the velocity cells are
+         * removed. The first feasible configuration is returned. If none is,
+         * the bottom tracking-only plan is returned, with feasible set to
+         * false
+         *
+         * Throws std::invalid_argument if \c baudrate is not positive
+         */
+        static BandwidthPlan propose(DataSelection const& desired, int cell_count,
+                int baudrate, float ensemble_rate, base::Time const& latency_budget = base::Time());
+    };
+}
+
+#endif
+
@@ -0,0 +1,155 @@
+#include <dvl_teledyne/BeamTransform.hpp>
+#include <base/Float.hpp>
+#include <stdexcept>
+#include <cmath>
+
+using namespace dvl_teledyne;
+
+BeamGeometry::BeamGeometry()
+    : beam_angle(M_PI / 180 * 30)
+    , convex(true)
+    , upward(false)
+{
+}
+
+BeamGeometry BeamGeometry::fromDeviceInfo(DeviceInfo const& info)
+{
+    BeamGeometry result;
+    // Bit 3 of the LSB is set for a convex transducer head
+    result.convex = info.system_configuration & 0x0008;
+    // Bit 7 of the LSB is set for an up-facing transducer
+    result.upward = info.system_configuration & 0x0080;
+    // Bits 0-1 of the MSB are the beam angle
+    switch ((info.system_configuration >> 8) & 0x3)
+    {
+    case 0: result.beam_angle = M_PI / 180 * 15; break;
+    case 1: result.beam_angle = M_PI / 180 * 20; break;
+    case 2: result.beam_angle = M_PI / 180 * 30; break;
+    default: result.beam_angle = base::unknown<float>();
+    }
+    return result;
+}
+
+BeamTransform::BeamTransform()
+{
+    configure(BeamGeometry());
+}
+
+BeamTransform::BeamTransform(BeamGeometry const& geometry)
+{
+    configure(geometry);
+}
+
+BeamGeometry const& BeamTransform::getGeometry() const
+{
+    return mGeometry;
+}
+
+void BeamTransform::configure(BeamGeometry const& geometry)
+{
+    if (base::isUnknown(geometry.beam_angle))
+        throw std::invalid_argument("BeamTransform: unknown beam angle");
+
+    mGeometry = geometry;
+
+    // See the Teledyne RDI "ADCP Coordinate Transformation" booklet
+    float c = geometry.convex ? 1 : -1;
+    float a = 1.0 / (2 * sin(geometry.beam_angle));
+    float b = 1.0 / (4 * cos(geometry.beam_angle));
+    float d = a / sqrt(2.0);
+    float const matrix[4][4] = {
+        { c * a, -c * a,      0,     0 },
+        {     0,      0, -c * a, c * a },
+        {     b,      b,      b,     b },
+        {     d,      d,     -d,    -d }
+    };
+    for (int row = 0; row < 4; ++row)
+        for (int beam = 0; beam < 4; ++beam)
+            mFourBeam[row][beam] = matrix[row][beam];
+
+    // A 3-beam solution assumes that the error velocity is zero. The missing
+    // beam is then a linear combination of the other three:
+    //
+    //   sign[dropped] * v[dropped] = - sum(sign[beam] * v[beam])
+    //
+    // which we fold into the X, Y and Z rows
+    float const sign[4] = { 1, 1, -1, -1 };
+    for (int dropped = 0; dropped < 4; ++dropped)
+    {
+        for (int row = 0; row < 3; ++row)
+        {
+            int col = 0;
+            for (int beam = 0; beam < 4; ++beam)
+            {
+                if (beam == dropped)
+                    continue;
+                mThreeBeam[dropped][row][col++] =
+                    matrix[row][beam] - matrix[row][dropped] * sign[dropped] * sign[beam];
+            }
+        }
+    }
+}
+
+BottomTrackingSolution BeamTransform::solve(BottomTracking const& tracking) const
+{
+    BottomTrackingSolution result = solve(tracking.velocity);
+    result.time = tracking.time;
+    return result;
+}
+
+BottomTrackingSolution BeamTransform::solve(float const* beam_velocities) const
+{
+    BottomTrackingSolution result;
+    result.dropped_beam = -1;
+    for (int beam = 0; beam < 4; ++beam)
+    {
+        if (base::isUnknown(beam_velocities[beam]))
+        {
+            if (result.dropped_beam != -1)
+            {
+                result.type = SOLUTION_NONE;
+                result.dropped_beam = -1;
+                for (int i = 0; i < 3; ++i)
+                    result.velocity[i] = base::unknown<float>();
+                result.error_velocity = base::unknown<float>();
+                return result;
+            }
+            result.dropped_beam = beam;
+        }
+    }
+
+    if (result.dropped_beam == -1)
+    {
+        result.type = SOLUTION_4BEAM;
+        for (int row = 0; row < 3; ++row)
+        {
+            float const* m = mFourBeam[row];
+            result.velocity[row] =
+                m[0] * beam_velocities[0] + m[1] * beam_velocities[1] +
+                m[2] * beam_velocities[2] + m[3] * beam_velocities[3];
+        }
+        float const* m = mFourBeam[3];
+        result.error_velocity =
+            m[0] * beam_velocities[0] + m[1] * beam_velocities[1] +
+            m[2] * beam_velocities[2] + m[3] * beam_velocities[3];
+        return result;
+    }
+
+    float v[3];
+    int col = 0;
+    for (int beam = 0; beam < 4; ++beam)
+    {
+        if (beam != result.dropped_beam)
+            v[col++] = beam_velocities[beam];
+    }
+
+    result.type = SOLUTION_3BEAM;
+    for (int row = 0; row < 3; ++row)
+    {
+        float const* m = mThreeBeam[result.dropped_beam][row];
+        result.velocity[row] = m[0] * v[0] + m[1] * v[1] + m[2] * v[2];
+    }
+    result.error_velocity = base::unknown<float>();
+    return result;
+}
+
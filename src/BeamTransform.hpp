@@ -0,0 +1,101 @@
+#ifndef DVL_TELEDYNE_BEAMTRANSFORM_HPP
+#define DVL_TELEDYNE_BEAMTRANSFORM_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+
+namespace dvl_teledyne
+{
+    /** Geometry of a 4-beam janus transducer head */
+    struct BeamGeometry
+    {
+        /** Angle between each beam and the transducer axis, in radians */
+        float beam_angle;
+        /** True for a convex head, false for a concave one */
+        bool convex;
+        /** True if the transducer faces up, false if it faces down */
+        bool upward;
+
+        BeamGeometry();
+
+        /** Extracts the geometry from the system configuration word of the
+         * fixed leader
+         *
+         * beam_angle is set to unknown if the device reports a non-standard
+         * beam angle. It has then to be set manually.
+         */
+        static BeamGeometry fromDeviceInfo(DeviceInfo const& info);
+    };
+
+    enum SOLUTION_TYPES
+    {
+        /** Two beams or more are missing, no velocity could be computed */
+        SOLUTION_NONE,
+        /** One beam is missing, the velocity has been computed from the three
+         * remaining ones. There is no error velocity
+         */
+        SOLUTION_3BEAM,
+        /** All four beams are valid */
+        SOLUTION_4BEAM
+    };
+
+    /** Bottom tracking velocity computed on the host from the beam velocities
+     */
+    struct BottomTrackingSolution
+    {
+        /** Acquisition timestamp */
+        base::Time time;
+        /** Velocity in the instrument frame (Beam2-Beam1, Beam4-Beam3, to
+         * transducer), in m/s
+         */
+        float velocity[3];
+        /** Error velocity in m/s. Unknown for a 3-beam solution */
+        float error_velocity;
+        /** Beam that got discarded for a 3-beam solution, -1 otherwise */
+        int dropped_beam;
+        SOLUTION_TYPES type;
+    };
+
+    /** Beam to instrument transformation of the bottom tracking velocities
+     *
+     * This is meant to be used when the device outputs its data in BEAM
+     * coordinates. Whenever exactly one beam lost bottom lock, it computes a
+     * 3-beam solution (by assuming a zero error velocity) instead of
+     * discarding the whole ensemble.
+     *
+     * All the transformation matrices are computed in configure(), so that
+     * solve() only does a few multiply-adds.
+     */
+    class BeamTransform
+    {
+    public:
+        BeamTransform();
+        BeamTransform(BeamGeometry const& geometry);
+
+        /** Precomputes the transformation matrices for the given geometry */
+        void configure(BeamGeometry const& geometry);
+        BeamGeometry const& getGeometry() const;
+
+        /** Computes the velocity from the bottom tracking beam velocities
+         *
+         * The tracking data must be expressed in BEAM coordinates
+         */
+        BottomTrackingSolution solve(BottomTracking const& tracking) const;
+
+        /** Computes the velocity from four beam velocities, using a 3-beam
+         * solution if one of them is unknown
+         */
+        BottomTrackingSolution solve(float const* beam_velocities) const;
+
+    private:
+        BeamGeometry mGeometry;
+        /** Rows are X, Y, Z and error velocity */
+        float mFourBeam[4][4];
+        /** Indexed by dropped beam. Rows are X, Y and Z, columns are the
+         * remaining beams in increasing order
+         */
+        float mThreeBeam[4][3][3];
+    };
+}
+
+#endif
+
@@ -0,0 +1,352 @@
+#include <dvl_teledyne/CompactFormats.hpp>
+#include <boost/static_assert.hpp>
+#include <base/Float.hpp>
+#include <algorithm>
+#include <endian.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+using namespace dvl_teledyne;
+
+namespace dvl_teledyne
+{
+    namespace raw
+    {
+        struct PD4Message
+        {
+            enum MSG_ID { ID = 0x7d };
+            enum STRUCTURES { STRUCTURE_PD4 = 0, STRUCTURE_PD5 = 1 };
+            enum SYSTEM_CONFIGURATION
+            {
+                COORDINATE_SYSTEM_MASK = 0xC0,
+                COORD_BEAM       = 0x00,
+                COORD_INSTRUMENT = 0x40,
+                COORD_SHIP       = 0x80,
+                COORD_EARTH      = 0xC0,
+                USE_ATTITUDE      = 0x20,
+                USE_3BEAM_SOLUTION = 0x10
+            };
+
+            uint8_t  id;
+            uint8_t  structure;
+            uint16_t size;
+            uint8_t  system_configuration;
+            uint16_t bottom_velocity[4];
+            uint16_t bottom_range[4];
+            uint8_t  bottom_status;
+            uint16_t reference_velocity[4];
+            uint16_t reference_start;
+            uint16_t reference_end;
+            uint8_t  reference_status;
+            uint8_t  tofp_hour;
+            uint8_t  tofp_min;
+            uint8_t  tofp_sec;
+            uint8_t  tofp_hundredth;
+            uint16_t self_test_result;
+            uint16_t speed_of_sound;
+            uint16_t temperature;
+        } __attribute__((packed));
+        BOOST_STATIC_ASSERT(sizeof(PD4Message) == 45);
+
+        struct PD5Extension
+        {
+            uint8_t  salinity;
+            uint16_t depth;
+            uint16_t pitch;
+            uint16_t roll;
+            uint16_t heading;
+            uint32_t bottom_distance[4];
+            uint32_t reference_distance[4];
+        } __attribute__((packed));
+        BOOST_STATIC_ASSERT(sizeof(PD4Message) + sizeof(PD5Extension) == 86);
+
+        static const size_t PD45_CHECKSUM_SIZE = 2;
+    }
+}
+
+const size_t dvl_teledyne::PD4_ENSEMBLE_SIZE =
+    sizeof(raw::PD4Message) + raw::PD45_CHECKSUM_SIZE;
+const size_t dvl_teledyne::PD5_ENSEMBLE_SIZE =
+    sizeof(raw::PD4Message) + sizeof(raw::PD5Extension) + raw::PD45_CHECKSUM_SIZE;
+
+namespace
+{
+    /** Maximum length of a PD6 line, including the CR LF */
+    static const size_t MAX_PD6_LINE = 128;
+
+    uint16_t computeChecksum(uint8_t const* buffer, size_t size)
+    {
+        uint16_t checksum = 0;
+        for (size_t i = 0; i < size; ++i)
+            checksum += buffer[i];
+        return checksum;
+    }
+
+    float velocityFromMillimeters(int value)
+    {
+        if (value == -32768)
+            return base::unknown<float>();
+        return 1e-3f * value;
+    }
+
+    base::Quaterniond orientationFromDegrees(double pitch, double roll, double heading)
+    {
+        return Eigen::AngleAxisd(M_PI / 180 * roll,    Eigen::Vector3d::UnitX()) *
+            Eigen::AngleAxisd(M_PI / 180 * pitch,   Eigen::Vector3d::UnitY()) *
+            Eigen::AngleAxisd(M_PI / 180 * heading, Eigen::Vector3d::UnitZ());
+    }
+}
+
+char const* dvl_teledyne::outputFormatCommand(OUTPUT_FORMATS format)
+{
+    switch(format)
+    {
+    case FORMAT_PD0: return "PD0";
+    case FORMAT_PD4: return "PD4";
+    case FORMAT_PD5: return "PD5";
+    case FORMAT_PD6: return "PD6";
+    }
+    return "PD0";
+}
+
+int dvl_teledyne::extractPD45Packet(uint8_t const* buffer, size_t size)
+{
+    size_t packet_start;
+    for (packet_start = 0; packet_start < size; ++packet_start)
+    {
+        if (buffer[packet_start] == raw::PD4Message::ID)
+            break;
+    }
+    if (packet_start)
+        return -packet_start;
+    else if (size < 4)
+        return 0;
+
+    uint16_t expected_size = 0;
+    if (buffer[1] == raw::PD4Message::STRUCTURE_PD4)
+        expected_size = sizeof(raw::PD4Message);
+    else if (buffer[1] == raw::PD4Message::STRUCTURE_PD5)
+        expected_size = sizeof(raw::PD4Message) + sizeof(raw::PD5Extension);
+
+    // The size field EXCLUDES the checksum
+    uint16_t ensemble_size = buffer[2] | buffer[3] << 8;
+    if (ensemble_size != expected_size)
+        return -1;
+    else if (size < ensemble_size + 2u)
+        return 0;
+
+    uint16_t msg_checksum = buffer[ensemble_size] | buffer[ensemble_size + 1] << 8;
+    if (computeChecksum(buffer, ensemble_size) != msg_checksum)
+        return -1;
+    return ensemble_size + 2;
+}
+
+int dvl_teledyne::extractPD6Packet(uint8_t const* buffer, size_t size)
+{
+    size_t packet_start;
+    for (packet_start = 0; packet_start < size; ++packet_start)
+    {
+        if (buffer[packet_start] == ':')
+            break;
+    }
+    if (packet_start)
+        return -packet_start;
+
+    size_t max_size = std::min(size, MAX_PD6_LINE);
+    for (size_t i = 1; i < max_size; ++i)
+    {
+        if (buffer[i] == '\n')
+            return i + 1;
+        else if (buffer[i] == ':')
+            return -i;
+    }
+    if (size >= MAX_PD6_LINE)
+        return -1;
+    return 0;
+}
+
+PARSE_STATUS dvl_teledyne::parsePD45Ensemble(uint8_t const* buffer, size_t size,
+        OutputConfiguration& outputConf, Status& status, BottomTracking& tracking)
+{
+    if (size < sizeof(raw::PD4Message))
+        return PARSE_TRUNCATED_MESSAGE;
+
+    raw::PD4Message const& msg = *reinterpret_cast<raw::PD4Message const*>(buffer);
+    bool is_pd5 = (msg.structure == raw::PD4Message::STRUCTURE_PD5);
+    if (is_pd5 && size < sizeof(raw::PD4Message) + sizeof(raw::PD5Extension))
+        return PARSE_TRUNCATED_MESSAGE;
+
+    switch(msg.system_configuration & raw::PD4Message::COORDINATE_SYSTEM_MASK)
+    {
+    case raw::PD4Message::COORD_BEAM:
+        outputConf.coordinate_system = BEAM;
+        break;
+    case raw::PD4Message::COORD_INSTRUMENT:
+        outputConf.coordinate_system = INSTRUMENT;
+        break;
+    case raw::PD4Message::COORD_SHIP:
+        outputConf.coordinate_system = SHIP;
+        break;
+    case raw::PD4Message::COORD_EARTH:
+        outputConf.coordinate_system = EARTH;
+        break;
+    }
+    outputConf.use_attitude       = msg.system_configuration & raw::PD4Message::USE_ATTITUDE;
+    outputConf.use_3beam_solution = msg.system_configuration & raw::PD4Message::USE_3BEAM_SOLUTION;
+
+    {
+        // Unlike the PD0 variable leader, PD4 only reports the time of
+        // day
+        time_t utc_epoch = ::time(NULL);
+        tm utc_hms;
+        gmtime_r(&utc_epoch, &utc_hms);
+        utc_hms.tm_hour = msg.tofp_hour;
+        utc_hms.tm_min  = msg.tofp_min;
+        utc_hms.tm_sec  = msg.tofp_sec;
+        time_t since_epoch = timegm(&utc_hms);
+        status.time = base::Time::fromSeconds(since_epoch, static_cast<uint64_t>(msg.tofp_hundredth) * 10000);
+    }
+    status.seq++;
+    status.self_test_result = le16toh(msg.self_test_result);
+    status.speed_of_sound   = 1.0f * le16toh(msg.speed_of_sound);
+    status.temperature      = 1e-2f * static_cast<int16_t>(le16toh(msg.temperature));
+
+    tracking.time = status.time;
+    for (int beam = 0; beam < 4; ++beam)
+    {
+        tracking.velocity[beam] = velocityFromMillimeters(static_cast<int16_t>(le16toh(msg.bottom_velocity[beam])));
+        uint16_t range = le16toh(msg.bottom_range[beam]);
+        if (range)
+            tracking.range[beam] = 1e-2f * range;
+        else
+            tracking.range[beam] = base::unknown<float>();
+        tracking.correlation[beam]     = base::unknown<float>();
+        tracking.evaluation[beam]      = base::unknown<float>();
+        tracking.good_ping_ratio[beam] = base::unknown<float>();
+        tracking.rssi[beam]            = base::unknown<float>();
+        tracking.water_layer_velocity[beam] =
+            velocityFromMillimeters(static_cast<int16_t>(le16toh(msg.reference_velocity[beam])));
+        tracking.water_layer_correlation[beam]     = base::unknown<float>();
+        tracking.water_layer_intensity[beam]       = base::unknown<float>();
+        tracking.water_layer_good_ping_ratio[beam] = base::unknown<float>();
+    }
+
+    if (is_pd5)
+    {
+        raw::PD5Extension const& ext =
+            *reinterpret_cast<raw::PD5Extension const*>(buffer + sizeof(raw::PD4Message));
+        status.salinity = 1e-3f * ext.salinity;
+        status.depth    = 1e-1f * le16toh(ext.depth);
+        status.orientation = orientationFromDegrees(
+                0.01 * static_cast<int16_t>(le16toh(ext.pitch)),
+                0.01 * static_cast<int16_t>(le16toh(ext.roll)),
+                0.01 * le16toh(ext.heading));
+    }
+    return PARSE_OK;
+}
+
+PARSE_STATUS dvl_teledyne::parsePD6Line(uint8_t const* buffer, size_t size,
+        OutputConfiguration const& outputConf, Status& status, BottomTracking& tracking,
+        bool& end_of_ensemble)
+{
+    end_of_ensemble = false;
+    if (size < 4 || size > MAX_PD6_LINE)
+        return PARSE_TRUNCATED_MESSAGE;
+
+    char line[MAX_PD6_LINE + 1];
+    memcpy(line, buffer, size);
+    line[size] = 0;
+    char const* id = line + 1;
+
+    if (!strncmp(id, "SA,", 3))
+    {
+        // First line of an ensemble. The bottom tracking lines that follow
+        // may be missing or garbled, they must not leave the values of the
+        // previous ensemble
+        invalidateBottomTracking(tracking);
+
+        float pitch, roll, heading;
+        if (sscanf(line, ":SA,%f,%f,%f", &pitch, &roll, &heading) != 3)
+            return PARSE_INVALID_VALUE;
+        status.orientation = orientationFromDegrees(pitch, roll, heading);
+    }
+    else if (!strncmp(id, "TS,", 3))
+    {
+        int year, month, day, hour, min, sec, hundredth, self_test;
+        float salinity, temperature, depth, speed_of_sound;
+        if (sscanf(line, ":TS,%2d%2d%2d%2d%2d%2d%2d,%f,%f,%f,%f,%d",
+                    &year, &month, &day, &hour, &min, &sec, &hundredth,
+                    &salinity, &temperature, &depth, &speed_of_sound, &self_test) != 12)
+            return PARSE_INVALID_VALUE;
+
+        tm utc_hms;
+        memset(&utc_hms, 0, sizeof(utc_hms));
+        utc_hms.tm_year = 100 + year;
+        utc_hms.tm_mon  = month - 1;
+        utc_hms.tm_mday = day;
+        utc_hms.tm_hour = hour;
+        utc_hms.tm_min  = min;
+        utc_hms.tm_sec  = sec;
+        status.time = base::Time::fromSeconds(timegm(&utc_hms), static_cast<uint64_t>(hundredth) * 10000);
+        status.seq++;
+        status.salinity       = 1e-3f * salinity;
+        status.temperature    = temperature;
+        status.depth          = depth;
+        status.speed_of_sound = speed_of_sound;
+        status.self_test_result = self_test;
+        tracking.time = status.time;
+    }
+    else if (!strncmp(id, "RA,", 3))
+    {
+        float pressure, range[4];
+        if (sscanf(line, ":RA,%f,%f,%f,%f,%f", &pressure, &range[0], &range[1], &range[2], &range[3]) != 5)
+            return PARSE_INVALID_VALUE;
+        status.pressure = 1e3f * pressure;
+        for (int beam = 0; beam < 4; ++beam)
+            tracking.range[beam] = (range[beam] > 0) ? range[beam] : base::unknown<float>();
+    }
+    else if (!strncmp(id, "BI,", 3) || !strncmp(id, "BS,", 3) || !strncmp(id, "BE,", 3))
+    {
+        COORDINATE_SYSTEMS line_system = INSTRUMENT;
+        if (id[1] == 'S')
+            line_system = SHIP;
+        else if (id[1] == 'E')
+            line_system = EARTH;
+
+        COORDINATE_SYSTEMS wanted = outputConf.coordinate_system;
+        if (wanted == BEAM)
+            wanted = INSTRUMENT;
+        if (line_system != wanted)
+            return PARSE_OK;
+
+        int velocity[4] = { -32768, -32768, -32768, -32768 };
+        char flag = 'V';
+        if (line_system == INSTRUMENT)
+        {
+            if (sscanf(line + 4, "%d,%d,%d,%d,%c", &velocity[0], &velocity[1], &velocity[2], &velocity[3], &flag) != 5)
+                return PARSE_INVALID_VALUE;
+        }
+        else if (sscanf(line + 4, "%d,%d,%d,%c", &velocity[0], &velocity[1], &velocity[2], &flag) != 4)
+            return PARSE_INVALID_VALUE;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (flag == 'A')
+                tracking.velocity[i] = velocityFromMillimeters(velocity[i]);
+            else
+                tracking.velocity[i] = base::unknown<float>();
+        }
+        for (int beam = 0; beam < 4; ++beam)
+        {
+            tracking.correlation[beam]     = base::unknown<float>();
+            tracking.evaluation[beam]      = base::unknown<float>();
+            tracking.good_ping_ratio[beam] = base::unknown<float>();
+            tracking.rssi[beam]            = base::unknown<float>();
+        }
+    }
+    else if (!strncmp(id, "BD,", 3))
+        end_of_ensemble = true;
+
+    return PARSE_OK;
+}
@@ -0,0 +1,83 @@
+#ifndef DVL_TELEDYNE_COMPACTFORMATS_HPP
+#define DVL_TELEDYNE_COMPACTFORMATS_HPP
+
+#include <dvl_teledyne/PD0Parser.hpp>
+
+namespace dvl_teledyne
+{
+    /** Output data formats supported by the driver (see the PD command) */
+    enum OUTPUT_FORMATS
+    {
+        /** Full ensembles, with the leaders, the depth cells and the bottom
+         * tracking
+         */
+        FORMAT_PD0,
+        /** Binary bottom tracking and water reference layer velocities, 47
+         * bytes per ensemble
+         */
+        FORMAT_PD4,
+        /** PD4, plus salinity, depth, attitude and distance made good. 88
+         * bytes per ensemble
+         */
+        FORMAT_PD5,
+        /** ASCII lines for attitude, timing, bottom tracking and water
+         * reference layer
+         */
+        FORMAT_PD6
+    };
+
+    /** Size in bytes of a PD4 ensemble, including its checksum */
+    extern const size_t PD4_ENSEMBLE_SIZE;
+    /** Size in bytes of a PD5 ensemble, including its checksum */
+    extern const size_t PD5_ENSEMBLE_SIZE;
+
+    /** Returns the command that selects \c format on the device, without
+     * the trailing newline (e.g. "PD4")
+     */
+    char const* outputFormatCommand(OUTPUT_FORMATS format);
+
+    /** Framing of PD4 and PD5 ensembles, following the conventions of
+     * iodrivers_base::Driver::extractPacket
+     */
+    int extractPD45Packet(uint8_t const* buffer, size_t size);
+
+    /** Framing of PD6 lines, following the conventions of
+     * iodrivers_base::Driver::extractPacket
+     *
+     * Each PD6 line is returned as a separate packet, see parsePD6Line
+     */
+    int extractPD6Packet(uint8_t const* buffer, size_t size);
+
+    /** Decodes a PD4 or PD5 ensemble as returned by extractPD45Packet
+     *
+     * The coordinate system, the use of attitude and of 3-beam solutions are
+     * updated in \c outputConf. The fields that these formats do not provide
+     * (correlation, evaluation, good ping ratio, RSSI and all water-layer
+     * values but the velocity in \c tracking, and everything except time,
+     * speed of sound, temperature and the self test result in \c status for
+     * PD4) are set to NaN or left untouched.
+     * Since the formats have no ensemble number, \c status.seq is
+     * incremented for each ensemble.
+     */
+    PARSE_STATUS parsePD45Ensemble(uint8_t const* buffer, size_t size,
+            OutputConfiguration& outputConf, Status& status, BottomTracking& tracking);
+
+    /** Decodes one PD6 line as returned by extractPD6Packet
+     *
+     * The device outputs the bottom tracking velocities in instrument, ship
+     * and earth coordinates. \c tracking.velocity is filled with the ones that
+     * match \c outputConf.coordinate_system (instrument coordinates in BEAM
+     * mode, as there are no beam velocities in PD6). Water-mass lines are
+     * ignored. All the values of \c tracking are set to unknown on the
+     * first line of an ensemble (the SA line).
+     *
+     * \c end_of_ensemble is set to true if the line is the last one of an
+     * ensemble (the BD line), and false otherwise.
+     */
+    PARSE_STATUS parsePD6Line(uint8_t const* buffer, size_t size,
+            OutputConfiguration const& outputConf, Status& status, BottomTracking& tracking,
+            bool& end_of_ensemble);
+}
+
+#endif
+
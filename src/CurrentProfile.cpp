@@ -0,0 +1,238 @@
+#include <dvl_teledyne/CurrentProfile.hpp>
+#include <dvl_teledyne/BeamTransform.hpp>
+#include <dvl_teledyne/PD0Parser.hpp>
+#include <base/Float.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace dvl_teledyne;
+
+namespace
+{
+    /** Weight factor of a value that may not be output by the device */
+    float weightOf(float value)
+    {
+        return base::isNaN(value) ? 1 : value;
+    }
+
+    /** Weighted sums of a layer, per component */
+    struct LayerSums
+    {
+        float weight[4];
+        float weighted[4];
+        float weighted_squares[4];
+        float count[4];
+    };
+
+    void finalize(LayerSums const& sums, LayerCurrent& layer)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            layer.cell_count[i] = sums.count[i];
+            if (sums.weight[i] > 0)
+            {
+                float mean = sums.weighted[i] / sums.weight[i];
+                layer.velocity[i] = mean;
+                layer.variance[i] = std::max(0.0f, sums.weighted_squares[i] / sums.weight[i] - mean * mean);
+            }
+            else
+            {
+                layer.velocity[i] = base::unknown<float>();
+                layer.variance[i] = base::unknown<float>();
+            }
+        }
+    }
+}
+
+ProfileLayer::ProfileLayer()
+    : min_depth(0)
+    , max_depth(0)
+{
+}
+
+ProfileLayer::ProfileLayer(float min_depth, float max_depth)
+    : min_depth(min_depth)
+    , max_depth(max_depth)
+{
+}
+
+CurrentProfiler::CurrentProfiler(std::vector<ProfileLayer> const& layers)
+{
+    setLayers(layers);
+    mProfile.coordinate_system = BEAM;
+}
+
+void CurrentProfiler::setLayers(std::vector<ProfileLayer> const& layers)
+{
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        if (!(layers[i].min_depth <= layers[i].max_depth))
+            throw std::invalid_argument("CurrentProfiler: the minimum depth of a layer must not be greater than its maximum depth");
+    }
+    mLayers = layers;
+    mProfile.layers.resize(layers.size());
+}
+
+std::vector<ProfileLayer> const& CurrentProfiler::getLayers() const
+{
+    return mLayers;
+}
+
+CurrentProfile const& CurrentProfiler::getProfile() const
+{
+    return mProfile;
+}
+
+void CurrentProfiler::update(PD0Parser const& parser)
+{
+    updateImpl(parser);
+}
+
+void CurrentProfiler::update(Ensemble const& ensemble)
+{
+    updateImpl(ensemble);
+}
+
+template<typename Source>
+void CurrentProfiler::updateImpl(Source const& source)
+{
+    CellReadings const& readings = source.cellReadings;
+    mProfile.time = readings.time;
+    mProfile.coordinate_system = source.outputConf.coordinate_system;
+
+    // Vertical component of the transducer axis. With bin mapping, the
+    // device already places the cells at constant depths
+    float vertical = 1;
+    if (!source.outputConf.use_bin_mapping)
+    {
+        float axis = source.status.orientation.toRotationMatrix()(2, 2);
+        if (!base::isNaN(axis))
+            vertical = std::fabs(axis);
+    }
+    if (BeamGeometry::fromDeviceInfo(source.deviceInfo).upward)
+        vertical = -vertical;
+
+    AcquisitionConfiguration const& acq = source.acqConf;
+    float depth = source.status.depth;
+    mProfile.cell_depths.resize(readings.readings.size());
+    for (size_t i = 0; i < readings.readings.size(); ++i)
+        mProfile.cell_depths[i] = depth + vertical * (acq.first_cell_distance + i * acq.cell_length);
+
+    computeWeights(readings, source.outputConf.coordinate_system);
+    for (size_t i = 0; i < mLayers.size(); ++i)
+    {
+        LayerCurrent& layer = mProfile.layers[i];
+        layer.min_depth = mLayers[i].min_depth;
+        layer.max_depth = mLayers[i].max_depth;
+        reduce(readings, layer);
+    }
+
+    BottomTrackingConfiguration const& tracking_conf = source.bottomTrackingConf;
+    float near_depth = depth + vertical * tracking_conf.water_layer_near_boundary;
+    float far_depth  = depth + vertical * tracking_conf.water_layer_far_boundary;
+    mProfile.water_layer.min_depth = std::min(near_depth, far_depth);
+    mProfile.water_layer.max_depth = std::max(near_depth, far_depth);
+    reduce(readings, mProfile.water_layer);
+
+    BottomTracking const& tracking = source.bottomTracking;
+    for (int i = 0; i < 4; ++i)
+    {
+        mProfile.water_layer_reference[i]       = tracking.water_layer_velocity[i];
+        mProfile.water_layer_correlation[i]     = tracking.water_layer_correlation[i];
+        mProfile.water_layer_good_ping_ratio[i] = tracking.water_layer_good_ping_ratio[i];
+    }
+}
+
+void CurrentProfiler::computeWeights(CellReadings const& readings, COORDINATE_SYSTEMS coordinate_system)
+{
+    mWeights.resize(readings.readings.size() * 4);
+    for (size_t cell = 0; cell < readings.readings.size(); ++cell)
+    {
+        CellReading const& reading = readings.readings[cell];
+        float* weights = &mWeights[cell * 4];
+        if (coordinate_system == BEAM)
+        {
+            for (int beam = 0; beam < 4; ++beam)
+                weights[beam] = weightOf(reading.correlation[beam]) * weightOf(reading.quality[beam]);
+            continue;
+        }
+
+        float correlation = 0;
+        int beam_count = 0;
+        for (int beam = 0; beam < 4; ++beam)
+        {
+            if (!base::isNaN(reading.correlation[beam]))
+            {
+                correlation += reading.correlation[beam];
+                beam_count++;
+            }
+        }
+        float weight = (beam_count ? correlation / beam_count : 1) *
+            weightOf(reading.quality[0] + reading.quality[3]);
+        std::fill(weights, weights + 4, weight);
+    }
+}
+
+#ifdef __SSE2__
+void CurrentProfiler::reduce(CellReadings const& readings, LayerCurrent& layer) const
+{
+    __m128 const one = _mm_set1_ps(1);
+    __m128 weight   = _mm_setzero_ps();
+    __m128 weighted = _mm_setzero_ps();
+    __m128 weighted_squares = _mm_setzero_ps();
+    __m128 count    = _mm_setzero_ps();
+    for (size_t cell = 0; cell < readings.readings.size(); ++cell)
+    {
+        // The depth is the same for all components
+        float depth = mProfile.cell_depths[cell];
+        if (!(depth >= layer.min_depth && depth <= layer.max_depth))
+            continue;
+
+        __m128 velocity = _mm_loadu_ps(readings.readings[cell].velocity);
+        __m128 w = _mm_loadu_ps(&mWeights[cell * 4]);
+        __m128 mask = _mm_and_ps(_mm_cmpord_ps(velocity, velocity), _mm_cmpgt_ps(w, _mm_setzero_ps()));
+        w = _mm_and_ps(mask, w);
+        velocity = _mm_and_ps(mask, velocity);
+        __m128 wx = _mm_mul_ps(w, velocity);
+        weight   = _mm_add_ps(weight, w);
+        weighted = _mm_add_ps(weighted, wx);
+        weighted_squares = _mm_add_ps(weighted_squares, _mm_mul_ps(wx, velocity));
+        count    = _mm_add_ps(count, _mm_and_ps(mask, one));
+    }
+
+    LayerSums sums;
+    _mm_storeu_ps(sums.weight, weight);
+    _mm_storeu_ps(sums.weighted, weighted);
+    _mm_storeu_ps(sums.weighted_squares, weighted_squares);
+    _mm_storeu_ps(sums.count, count);
+    finalize(sums, layer);
+}
+#else
+void CurrentProfiler::reduce(CellReadings const& readings, LayerCurrent& layer) const
+{
+    LayerSums sums = LayerSums();
+    for (size_t cell = 0; cell < readings.readings.size(); ++cell)
+    {
+        float depth = mProfile.cell_depths[cell];
+        if (!(depth >= layer.min_depth && depth <= layer.max_depth))
+            continue;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            float velocity = readings.readings[cell].velocity[i];
+            float w = mWeights[cell * 4 + i];
+            if (base::isNaN(velocity) || !(w > 0))
+                continue;
+            sums.weight[i]   += w;
+            sums.weighted[i] += w * velocity;
+            sums.weighted_squares[i] += w * velocity * velocity;
+            sums.count[i]++;
+        }
+    }
+    finalize(sums, layer);
+}
+#endif
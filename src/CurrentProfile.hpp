@@ -0,0 +1,115 @@
+#ifndef DVL_TELEDYNE_CURRENTPROFILE_HPP
+#define DVL_TELEDYNE_CURRENTPROFILE_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+#include <vector>
+
+namespace dvl_teledyne
+{
+    class PD0Parser;
+
+    /** Depth range over which the water current gets averaged, in meters
+     * below the surface
+     */
+    struct ProfileLayer
+    {
+        float min_depth;
+        float max_depth;
+
+        ProfileLayer();
+        ProfileLayer(float min_depth, float max_depth);
+    };
+
+    /** Water current averaged over a layer */
+    struct LayerCurrent
+    {
+        float min_depth;
+        float max_depth;
+        /** Weighted mean of the velocity of the cells in the layer, in the
+         * coordinate system of the cell readings. Unknown if no cell of the
+         * layer has a valid velocity
+         */
+        float velocity[4];
+        /** Weighted variance of the velocity of the cells in the layer */
+        float variance[4];
+        /** Count of cells that contributed to each component */
+        int cell_count[4];
+    };
+
+    /** Water current profile computed by CurrentProfiler */
+    struct CurrentProfile
+    {
+        base::Time time;
+        COORDINATE_SYSTEMS coordinate_system;
+
+        /** Depth of the center of each cell, in meters below the surface */
+        std::vector<float> cell_depths;
+        /** Current in each of the layers given to CurrentProfiler, in the
+         * same order
+         */
+        std::vector<LayerCurrent> layers;
+
+        /** Current computed from the cells over the water reference layer
+         * of the bottom tracking (see BottomTrackingConfiguration)
+         */
+        LayerCurrent water_layer;
+        /** Water reference layer velocity, as computed by the device. It is
+         * expressed in the same coordinate system as the cell velocities
+         */
+        float water_layer_reference[4];
+        /** Correlation (between 0 and 1) and ratio of good pings of the
+         * device's water layer velocity
+         */
+        float water_layer_correlation[4];
+        float water_layer_good_ping_ratio[4];
+    };
+
+    /** Averages the depth cell velocities over depth layers
+     *
+     * Cells are mapped to depths from the transducer depth, the cell
+     * geometry and, unless the device already does bin mapping, the tilt of
+     * the transducer. The transducer is assumed level if the attitude is
+     * unknown. The mean and variance of each layer are weighted by
+     * the correlation and the quality of the cells. In BEAM coordinates,
+     * each beam is weighted by its own correlation and percentage of good
+     * pings. In other coordinate systems, all components of a cell are
+     * weighted by the mean correlation of the beams and by the ratio of
+     * 3-beam and 4-beam solutions. Weights of messages that are not output
+     * by the device are ignored.
+     *
+     * The four components of a cell are contiguous in CellReadings, so each
+     * layer is reduced with SSE, one cell per instruction, masking the
+     * components that are unknown or have a null weight.
+     */
+    class CurrentProfiler
+    {
+    public:
+        CurrentProfiler(std::vector<ProfileLayer> const& layers = std::vector<ProfileLayer>());
+
+        void setLayers(std::vector<ProfileLayer> const& layers);
+        std::vector<ProfileLayer> const& getLayers() const;
+
+        /** Computes the profile of the ensemble just decoded by \c parser */
+        void update(PD0Parser const& parser);
+        /** Computes the profile of \c ensemble */
+        void update(Ensemble const& ensemble);
+
+        CurrentProfile const& getProfile() const;
+
+    private:
+        std::vector<ProfileLayer> mLayers;
+        CurrentProfile mProfile;
+        /** Weight of each cell and component, indexed by cell * 4 +
+         * component
+         */
+        std::vector<float> mWeights;
+
+        template<typename Source>
+        void updateImpl(Source const& source);
+        void computeWeights(CellReadings const& readings, COORDINATE_SYSTEMS coordinate_system);
+        void reduce(CellReadings const& readings, LayerCurrent& layer) const;
+    };
+}
+
+#endif
+
@@ -1,15 +1,51 @@
 #include <dvl_teledyne/Driver.hpp>
+#include <dvl_teledyne/BandwidthPlanner.hpp>
 #include <sys/ioctl.h>
+#include <stdlib.h>
+#include <algorithm>
 #include <termios.h>
 #include <iostream>
 #include <fstream>
 
 using namespace dvl_teledyne;
 
+/** Status word bits that mean that the device restarted, see
+ * Driver::setSupervised
+ */
+static const uint32_t RESTART_FLAGS =
+    raw::PD0_STATUS_WATCHDOG_RESTART | raw::PD0_STATUS_POWER_FAIL;
+/** Stall timeout, in count of ensemble periods */
+static const int STALL_PERIODS = 3;
+
+/** Returns the baud rate of a serial:// URI, or 0 if the URI does not give
+ * one. The capacity of other links (e.g. TCP) is unknown
+ */
+static int baudrateFromURI(std::string const& uri)
+{
+    static const std::string SERIAL_SCHEME = "serial://";
+    if (uri.compare(0, SERIAL_SCHEME.size(), SERIAL_SCHEME) != 0)
+        return 0;
+    size_t separator = uri.rfind(':');
+    if (separator < SERIAL_SCHEME.size())
+        return 0;
+    return atoi(uri.c_str() + separator + 1);
+}
+
 Driver::Driver()
     : iodrivers_base::Driver(1000000)
     , mConfMode(false)
     , mDesiredBaudrate(9600)
+    , mLinkBaudrate(0)
+    , mOutputFormat(FORMAT_PD0)
+    , mLinkUtilization(0)
+    , mLinkSaturated(false)
+    , mSharedPublisher(0)
+    , mSupervised(false)
+    , mLastEnsembleSize(0)
+    , mRestartFlags(RESTART_FLAGS)
+    , mCommandState(COMMAND_IDLE)
+    , mPromptRetries(0)
+    , mResumeAcquisition(false)
 {
     m_read_timeout = base::Time::fromSeconds(1.);
     buffer.resize(1000000);
@@ -18,6 +54,7 @@ Driver::Driver()
 void Driver::open(std::string const& uri)
 {
     openURI(uri);
+    mLinkBaudrate = baudrateFromURI(uri);
     setConfigurationMode();
     if (mDesiredBaudrate != 9600)
         setDesiredBaudrate(mDesiredBaudrate);
@@ -51,7 +88,10 @@ void Driver::sendConfigurationFile(std::string const& file_name)
 void Driver::setDesiredBaudrate(int rate)
 {
     if (getFileDescriptor() != iodrivers_base::Driver::INVALID_FD)
+    {
         setDeviceBaudrate(rate);
+        mLinkBaudrate = rate;
+    }
     mDesiredBaudrate = rate;
 }
 
@@ -73,16 +113,282 @@ void Driver::setDeviceBaudrate(int rate)
         case 115200: code = 8; break;
         default: throw std::runtime_error("invalid baud rate specified");
     }
-    uint8_t data[7] = { 'C', 'B', '0' + code, '1', '1', '\n', 0 };
+    uint8_t data[7] = { 'C', 'B', static_cast<uint8_t>('0' + code), '1', '1', '\n', 0 };
     writePacket(data, 6, 100);
     readConfigurationAck(m_read_timeout);
 }
 
 void Driver::read()
 {
-    int packet_size = readPacket(&buffer[0], buffer.size());
+    if (!mSupervised)
+    {
+        readEnsemble(m_read_timeout);
+        return;
+    }
+
+    try
+    {
+        readEnsemble(getStallTimeout());
+    }
+    catch(iodrivers_base::TimeoutError const&)
+    {
+        mLinkStats.stall();
+        recover();
+        readEnsemble(getStallTimeout());
+        return;
+    }
+
+    if (checkDeviceRestart())
+    {
+        mLinkStats.deviceRestart();
+        recover();
+    }
+}
+
+int Driver::readRawPacket(base::Time const& timeout)
+{
+    return readPacket(&buffer[0], buffer.size(), timeout);
+}
+
+uint8_t const* Driver::getRawPacket() const
+{
+    return &buffer[0];
+}
+
+void Driver::readEnsemble(base::Time const& timeout)
+{
+    if (mOutputFormat == FORMAT_PD6)
+    {
+        readPD6Ensemble(timeout);
+        return;
+    }
+
+    int packet_size = readPacket(&buffer[0], buffer.size(), timeout);
     if (packet_size)
-        parseEnsemble(&buffer[0], packet_size);
+    {
+        ensembleReceived();
+        mLastEnsembleSize = packet_size;
+        if (mOutputFormat == FORMAT_PD0)
+            parseEnsemble(&buffer[0], packet_size);
+        else
+        {
+            PARSE_STATUS result = parsePD45Ensemble(&buffer[0], packet_size,
+                    outputConf, status, bottomTracking);
+            if (result != PARSE_OK)
+                throw std::runtime_error(parseStatusToString(result));
+        }
+        mSnapshots.publish(*this);
+        if (mSharedPublisher)
+            mSharedPublisher->publish(*this, mLastEnsembleTime, &buffer[0], packet_size);
+        checkLinkUsage(packet_size);
+    }
+}
+
+void Driver::readPD6Ensemble(base::Time const& timeout)
+{
+    bool end_of_ensemble = false;
+    size_t ensemble_size = 0;
+    while (!end_of_ensemble)
+    {
+        int packet_size = readPacket(&buffer[0], buffer.size(), timeout);
+        ensemble_size += packet_size;
+        PARSE_STATUS result = parsePD6Line(&buffer[0], packet_size,
+                outputConf, status, bottomTracking, end_of_ensemble);
+        if (result != PARSE_OK)
+            throw std::runtime_error(parseStatusToString(result));
+    }
+
+    mLinkStats.validEnsemble(ensemble_size);
+    ensembleReceived();
+    mLastEnsembleSize = ensemble_size;
+    mSnapshots.publish(*this);
+    // A PD6 ensemble is made of several lines, there is no single raw frame
+    if (mSharedPublisher)
+        mSharedPublisher->publish(*this, mLastEnsembleTime, 0, 0);
+    checkLinkUsage(ensemble_size);
+}
+
+void Driver::ensembleReceived()
+{
+    base::Time now = base::Time::now();
+    if (!mReconfigurationStart.isNull())
+    {
+        mLinkStats.reconfiguration(now - mReconfigurationStart);
+        mReconfigurationStart = base::Time();
+    }
+    else if (!mRecoveryStart.isNull())
+    {
+        mLinkStats.recovery(now - mRecoveryStart);
+        mRecoveryStart = base::Time();
+    }
+    else if (!mLastEnsembleTime.isNull())
+        mEnsemblePeriod = now - mLastEnsembleTime;
+    mLastEnsembleTime = now;
+}
+
+base::Time Driver::getConfiguredEnsemblePeriod() const
+{
+    // Only PD0 reports the acquisition configuration
+    if (mOutputFormat != FORMAT_PD0)
+        return base::Time();
+
+    // The device pings the water and the bottom in turn, so an ensemble
+    // takes at least all its pings
+    int pings = acqConf.pings_per_ensemble + bottomTrackingConf.ping_per_ensemble;
+    return acqConf.time_between_ping_groups * std::max(1, pings);
+}
+
+/** Link utilization above which the driver considers the link saturated */
+static const float LINK_SATURATION_THRESHOLD = 0.9;
+
+void Driver::checkLinkUsage(size_t size)
+{
+    if (!mLinkBaudrate)
+        return;
+
+    // Time needed to transmit one byte on the link
+    float byte_time = BandwidthPlanner::computeWireTime(1, mLinkBaudrate).toSeconds();
+    float demand = mLinkStats.get().bytes_per_second;
+    base::Time period = getConfiguredEnsemblePeriod();
+    if (!period.isNull())
+        demand = std::max<float>(demand, size / period.toSeconds());
+    mLinkUtilization = demand * byte_time;
+
+    bool saturated = (mLinkUtilization > LINK_SATURATION_THRESHOLD);
+    if (saturated && !mLinkSaturated)
+    {
+        std::cerr << "dvl_teledyne: the device needs " << demand << " bytes/s ("
+            << size << " bytes per ensemble), which is "
+            << static_cast<int>(100 * mLinkUtilization) << "% of the capacity of the "
+            << mLinkBaudrate << " bauds link. The data will be increasingly delayed"
+            << std::endl;
+    }
+    mLinkSaturated = saturated;
+}
+
+float Driver::getLinkUtilization() const
+{
+    return mLinkUtilization;
+}
+
+bool Driver::isLinkSaturated() const
+{
+    return mLinkSaturated;
+}
+
+void Driver::startReconfiguration()
+{
+    // If no ensemble got received yet, there is no gap to measure
+    mReconfigurationStart = mLastEnsembleTime;
+}
+
+void Driver::reconfigure(std::vector<std::string> const& commands)
+{
+    bool acquiring = !mConfMode;
+    if (acquiring)
+    {
+        startReconfiguration();
+        setConfigurationMode();
+    }
+
+    try
+    {
+        for (size_t i = 0; i < commands.size(); ++i)
+        {
+            std::string line = commands[i] + "\n";
+            writePacket(reinterpret_cast<uint8_t const*>(line.c_str()), line.length(), 100);
+            readConfigurationAck(m_read_timeout);
+        }
+    }
+    catch(...)
+    {
+        if (acquiring)
+            startAcquisition();
+        throw;
+    }
+
+    if (acquiring)
+        startAcquisition();
+}
+
+void Driver::setSupervised(bool enable)
+{
+    mSupervised = enable;
+}
+
+bool Driver::isSupervised() const
+{
+    return mSupervised;
+}
+
+void Driver::setStallTimeout(base::Time const& timeout)
+{
+    mStallTimeout = timeout;
+}
+
+base::Time Driver::getStallTimeout() const
+{
+    if (!mStallTimeout.isNull())
+        return mStallTimeout;
+
+    base::Time period = std::max(mEnsemblePeriod, getConfiguredEnsemblePeriod());
+    if (period.isNull())
+        return m_read_timeout;
+    base::Time timeout = period * STALL_PERIODS;
+    if (mLinkBaudrate)
+        timeout += BandwidthPlanner::computeWireTime(mLastEnsembleSize, mLinkBaudrate);
+    return timeout;
+}
+
+bool Driver::checkDeviceRestart()
+{
+    // Only PD0 has the status word
+    if (mOutputFormat != FORMAT_PD0)
+        return false;
+
+    uint32_t flags = status.status_word & RESTART_FLAGS;
+    bool restarted = (flags & ~mRestartFlags) != 0;
+    mRestartFlags = flags;
+    return restarted;
+}
+
+void Driver::recover()
+{
+    // Keep the start of the first attempt if the previous ones failed
+    if (mRecoveryStart.isNull())
+        mRecoveryStart = mLastEnsembleTime.isNull() ? base::Time::now() : mLastEnsembleTime;
+    mReconfigurationStart = base::Time();
+    // Keep the last measured period, the device pings at the same rate once
+    // it is back in acquisition
+
+    try
+    {
+        setConfigurationMode();
+        startAcquisition();
+    }
+    catch(...)
+    {
+        // Go back to acquisition mode anyway, so that the next read() gets
+        // the data if the device starts pinging by itself
+        mConfMode = false;
+        mLinkStats.recoveryFailure();
+        throw;
+    }
+}
+
+bool Driver::getSnapshot(Ensemble& ensemble) const
+{
+    return mSnapshots.read(ensemble);
+}
+
+uint64_t Driver::getSnapshotCount() const
+{
+    return mSnapshots.getPublishedCount();
+}
+
+void Driver::setSharedPublisher(SharedEnsemblePublisher* publisher)
+{
+    mSharedPublisher = publisher;
 }
 
 int Driver::extractPacket (uint8_t const *buffer, size_t buffer_size) const
@@ -111,11 +417,40 @@ int Driver::extractPacket (uint8_t const *buffer, size_t buffer_size) const
         else
             return -1;
     }
-    else
+    else if (mOutputFormat == FORMAT_PD0)
     {
         // std::cout << iodrivers_base::Driver::printable_com(buffer, buffer_size) << std::endl;
         return PD0Parser::extractPacket(buffer, buffer_size);
     }
+    else
+    {
+        int result;
+        if (mOutputFormat == FORMAT_PD6)
+            result = extractPD6Packet(buffer, buffer_size);
+        else
+            result = extractPD45Packet(buffer, buffer_size);
+
+        // A PD6 packet is a single line, the ensemble is counted once
+        // complete by readPD6Ensemble()
+        if (result < 0)
+            mLinkStats.discardedBytes(-result);
+        else if (result > 0 && mOutputFormat != FORMAT_PD6)
+            mLinkStats.validEnsemble(result);
+        return result;
+    }
+}
+
+void Driver::setOutputFormat(OUTPUT_FORMATS format)
+{
+    // The compact formats number the ensembles themselves
+    if (format != mOutputFormat)
+        status.seq = 0;
+    mOutputFormat = format;
+}
+
+OUTPUT_FORMATS Driver::getOutputFormat() const
+{
+    return mOutputFormat;
 }
 
 void Driver::setConfigurationMode()
@@ -166,9 +501,9 @@ void Driver::setOutputConfiguration(OutputConfiguration conf)
     uint8_t const cmd[7] = {
         'E', 'X',
         mode_codes_1[conf.coordinate_system], mode_codes_2[conf.coordinate_system],
-        (conf.use_attitude       ? '1' : '0'),
-        (conf.use_3beam_solution ? '1' : '0'),
-        (conf.use_bin_mapping ? '1' : '0') };
+        static_cast<uint8_t>(conf.use_attitude       ? '1' : '0'),
+        static_cast<uint8_t>(conf.use_3beam_solution ? '1' : '0'),
+        static_cast<uint8_t>(conf.use_bin_mapping ? '1' : '0') };
 
     writePacket(cmd, 7, 500);
 }
@@ -178,9 +513,240 @@ void Driver::startAcquisition()
     if (!mConfMode)
         throw std::logic_error("not in configuration mode");
 
-    writePacket(reinterpret_cast<uint8_t const*>("PD0\n"), 4, 100);
+    std::string format = std::string(outputFormatCommand(mOutputFormat)) + "\n";
+    writePacket(reinterpret_cast<uint8_t const*>(format.c_str()), format.length(), 100);
     readConfigurationAck(m_read_timeout);
     writePacket(reinterpret_cast<uint8_t const*>("CS\n"), 3, 100);
     mConfMode = false;
+    // Restart bits reported in the first ensembles predate this
+    // configuration
+    mRestartFlags = RESTART_FLAGS;
+}
+
+
+/** Duration of the break used to put the device in configuration mode */
+static const base::Time COMMAND_BREAK_DURATION = base::Time::fromMilliseconds(300);
+/** Count of times the driver asks for a prompt before giving up, see
+ * setConfigurationMode()
+ */
+static const int COMMAND_PROMPT_RETRIES = 12;
+
+void Driver::queueCommand(std::string const& command, CommandCallback const& callback)
+{
+    QueuedCommand queued;
+    queued.command = command;
+    queued.callback = callback;
+
+    std::lock_guard<std::mutex> lock(mCommandLock);
+    mCommandQueue.push_back(queued);
+}
+
+std::future<CommandResult> Driver::queueCommand(std::string const& command)
+{
+    std::shared_ptr< std::promise<CommandResult> > promise(new std::promise<CommandResult>());
+    queueCommand(command, [promise](CommandResult const& result) { promise->set_value(result); });
+    return promise->get_future();
+}
+
+bool Driver::hasPendingCommands() const
+{
+    std::lock_guard<std::mutex> lock(mCommandLock);
+    return mCommandState != COMMAND_IDLE || !mCommandQueue.empty();
+}
+
+void Driver::cancelCommands()
+{
+    std::deque<QueuedCommand> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(mCommandLock);
+        cancelled.swap(mCommandQueue);
+    }
+
+    CommandResult result;
+    result.status = COMMAND_CANCELLED;
+    for (size_t i = 0; i < cancelled.size(); ++i)
+    {
+        result.command = cancelled[i].command;
+        if (cancelled[i].callback)
+            cancelled[i].callback(result);
+    }
+}
+
+bool Driver::popCommand(QueuedCommand& command)
+{
+    std::lock_guard<std::mutex> lock(mCommandLock);
+    if (mCommandQueue.empty())
+        return false;
+    command = mCommandQueue.front();
+    mCommandQueue.pop_front();
+    return true;
+}
+
+int Driver::pollConfigurationReply()
+{
+    try { return readPacket(&buffer[0], buffer.size(), 0, 0); }
+    catch(iodrivers_base::TimeoutError const&) { return 0; }
+}
+
+void Driver::sendPromptRequest()
+{
+    writePacket(reinterpret_cast<uint8_t const*>("\n"), 1, 100);
+    mCommandState = COMMAND_WAIT_PROMPT;
+    mCommandDeadline = base::Time::now() + m_read_timeout;
 }
 
+void Driver::sendCommand(QueuedCommand const& command)
+{
+    // An error reply is framed up to its end of line, which leaves the
+    // prompt that follows it in the buffer. It must not be taken for the
+    // ack of this command
+    clear();
+    mCurrentCommand = command;
+    std::string line = command.command + "\n";
+    writePacket(reinterpret_cast<uint8_t const*>(line.c_str()), line.length(), 100);
+    mCommandState = COMMAND_WAIT_ACK;
+    mCommandDeadline = base::Time::now() + m_read_timeout;
+}
+
+void Driver::completeCommand(COMMAND_STATUS status, std::string const& reply)
+{
+    CommandResult result;
+    result.command = mCurrentCommand.command;
+    result.status = status;
+    result.reply = reply;
+    CommandCallback callback;
+    callback.swap(mCurrentCommand.callback);
+    if (callback)
+        callback(result);
+}
+
+void Driver::failCommands(COMMAND_STATUS status, std::string const& reply)
+{
+    do
+    {
+        completeCommand(status, reply);
+    }
+    while (popCommand(mCurrentCommand));
+}
+
+void Driver::startNextCommand()
+{
+    QueuedCommand command;
+    if (popCommand(command))
+        sendCommand(command);
+    else if (mResumeAcquisition)
+    {
+        std::string format = std::string(outputFormatCommand(mOutputFormat)) + "\n";
+        writePacket(reinterpret_cast<uint8_t const*>(format.c_str()), format.length(), 100);
+        mCommandState = COMMAND_WAIT_FORMAT_ACK;
+        mCommandDeadline = base::Time::now() + m_read_timeout;
+    }
+    else
+        mCommandState = COMMAND_IDLE;
+}
+
+bool Driver::processCommands()
+{
+    base::Time now = base::Time::now();
+    switch (mCommandState)
+    {
+        case COMMAND_IDLE:
+        {
+            QueuedCommand command;
+            if (!popCommand(command))
+                return false;
+
+            mResumeAcquisition = !mConfMode;
+            if (mConfMode)
+            {
+                sendCommand(command);
+                return true;
+            }
+
+            // Unlike tcsendbreak(), which blocks for the whole duration of
+            // the break, TIOCSBRK / TIOCCBRK let us time the break ourselves
+            mCurrentCommand = command;
+            startReconfiguration();
+            if (ioctl(getFileDescriptor(), TIOCSBRK))
+            {
+                failCommands(COMMAND_ERROR, "failed to send break");
+                throw iodrivers_base::UnixError("failed to set configuration mode");
+            }
+            mConfMode = true;
+            mCommandState = COMMAND_BREAK;
+            mCommandDeadline = now + COMMAND_BREAK_DURATION;
+            return true;
+        }
+
+        case COMMAND_BREAK:
+            if (now < mCommandDeadline)
+                return true;
+            if (ioctl(getFileDescriptor(), TIOCCBRK))
+            {
+                mCommandState = COMMAND_IDLE;
+                failCommands(COMMAND_ERROR, "failed to send break");
+                throw iodrivers_base::UnixError("failed to set configuration mode");
+            }
+            clear();
+            mPromptRetries = 0;
+            sendPromptRequest();
+            return true;
+
+        case COMMAND_WAIT_PROMPT:
+        {
+            int packet_size = pollConfigurationReply();
+            if (packet_size && buffer[0] == '>')
+            {
+                sendCommand(mCurrentCommand);
+                return true;
+            }
+            if (now < mCommandDeadline)
+                return true;
+            if (++mPromptRetries < COMMAND_PROMPT_RETRIES)
+            {
+                sendPromptRequest();
+                return true;
+            }
+
+            // The device did not answer. We cannot do anything with the
+            // queued commands, so fail them all
+            mCommandState = COMMAND_IDLE;
+            mConfMode = !mResumeAcquisition;
+            failCommands(COMMAND_TIMEOUT, "");
+            return false;
+        }
+
+        case COMMAND_WAIT_ACK:
+        {
+            int packet_size = pollConfigurationReply();
+            if (packet_size)
+            {
+                std::string reply(reinterpret_cast<char const*>(&buffer[0]), packet_size);
+                completeCommand(buffer[0] == '>' ? COMMAND_OK : COMMAND_ERROR, reply);
+            }
+            else if (now < mCommandDeadline)
+                return true;
+            else
+                completeCommand(COMMAND_TIMEOUT, "");
+
+            startNextCommand();
+            return mCommandState != COMMAND_IDLE;
+        }
+
+        case COMMAND_WAIT_FORMAT_ACK:
+        {
+            // Send CS even if the device did not ack the format command, so
+            // that it does not stay in configuration mode
+            int packet_size = pollConfigurationReply();
+            if (!packet_size && now < mCommandDeadline)
+                return true;
+
+            writePacket(reinterpret_cast<uint8_t const*>("CS\n"), 3, 100);
+            mConfMode = false;
+            mRestartFlags = RESTART_FLAGS;
+            mCommandState = COMMAND_IDLE;
+            return false;
+        }
+    }
+    return false;
+}
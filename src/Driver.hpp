@@ -3,9 +3,39 @@
 
 #include <iodrivers_base/Driver.hpp>
 #include <dvl_teledyne/PD0Parser.hpp>
+#include <dvl_teledyne/SnapshotBuffer.hpp>
+#include <dvl_teledyne/SharedEnsembleRing.hpp>
+#include <dvl_teledyne/CompactFormats.hpp>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
 
 namespace dvl_teledyne
 {
+    enum COMMAND_STATUS
+    {
+        /** The device acknowledged the command */
+        COMMAND_OK,
+        /** The device rejected the command, see CommandResult::reply */
+        COMMAND_ERROR,
+        /** The device did not answer in time */
+        COMMAND_TIMEOUT,
+        /** The command got removed from the queue by cancelCommands() */
+        COMMAND_CANCELLED
+    };
+
+    /** Outcome of a command queued with Driver::queueCommand */
+    struct CommandResult
+    {
+        std::string command;
+        COMMAND_STATUS status;
+        /** The device's answer, if there was one */
+        std::string reply;
+    };
+
+    typedef std::function<void (CommandResult const&)> CommandCallback;
+
     class Driver : public iodrivers_base::Driver, public PD0Parser
     {
         std::vector<uint8_t> buffer;
@@ -13,10 +43,126 @@ namespace dvl_teledyne
 
         bool mConfMode;
         int mDesiredBaudrate;
+        /** Baud rate of the link to the device, or 0 if unknown */
+        int mLinkBaudrate;
+        OUTPUT_FORMATS mOutputFormat;
+
+        /** Reads and decodes one ensemble in the configured format
+         *
+         * Throws iodrivers_base::TimeoutError if no ensemble is received
+         * within \c timeout
+         */
+        void readEnsemble(base::Time const& timeout);
+        /** Reads and decodes the lines of one PD6 ensemble */
+        void readPD6Ensemble(base::Time const& timeout);
+
+        /** Time between ensembles as configured on the device, i.e. the
+         * time between ping groups times the count of water and bottom
+         * pings per ensemble. Null if unknown
+         */
+        base::Time getConfiguredEnsemblePeriod() const;
+
+        float mLinkUtilization;
+        bool mLinkSaturated;
+        /** Updates the link utilization after the reception of an ensemble of
+         * \c size bytes, and warns when the link becomes saturated
+         */
+        void checkLinkUsage(size_t size);
+
+        /** Complete ensembles, published at the end of each read() */
+        SnapshotBuffer mSnapshots;
+        /** If set, complete ensembles are also published there */
+        SharedEnsemblePublisher* mSharedPublisher;
+
+        /** Reception time of the last ensemble */
+        base::Time mLastEnsembleTime;
+        /** Reception time of the last ensemble before the current
+         * reconfiguration. Null if there is no reconfiguration in progress
+         */
+        base::Time mReconfigurationStart;
+
+        /** Registers that the acquisition is being interrupted, so that the
+         * resulting gap gets reported in the link statistics
+         */
+        void startReconfiguration();
+
+        /** Updates the ensemble timing and reports the end of a
+         * reconfiguration or recovery when a new ensemble is received
+         */
+        void ensembleReceived();
+
+        bool mSupervised;
+        base::Time mStallTimeout;
+        /** Time between the last two ensembles received without
+         * interruption, used to compute the stall timeout
+         */
+        base::Time mEnsemblePeriod;
+        size_t mLastEnsembleSize;
+        /** Reception time of the last ensemble before the current recovery.
+         * Null if there is no recovery in progress
+         */
+        base::Time mRecoveryStart;
+        /** Restart bits of the status word in the last ensemble. The
+         * device is considered restarted when one of them gets set
+         */
+        uint32_t mRestartFlags;
+
+        /** Returns true if the last ensemble reports a device restart that
+         * was not reported by the previous ones
+         */
+        bool checkDeviceRestart();
+        /** Puts the device back in acquisition mode
+         *
+         * Throws if the device does not answer. The recovery stays in
+         * progress, i.e. the time to recover is reported once the data
+         * stream is back, even if it takes more than one attempt
+         */
+        void recover();
 
         /** Tells the DVL to switch to the desired rate */
         void setDeviceBaudrate(int rate);
 
+        /** States of the asynchronous command state machine, see
+         * processCommands()
+         */
+        enum COMMAND_STATES
+        {
+            COMMAND_IDLE,
+            COMMAND_BREAK,
+            COMMAND_WAIT_PROMPT,
+            COMMAND_WAIT_ACK,
+            COMMAND_WAIT_FORMAT_ACK
+        };
+
+        struct QueuedCommand
+        {
+            std::string command;
+            CommandCallback callback;
+        };
+
+        mutable std::mutex mCommandLock;
+        std::deque<QueuedCommand> mCommandQueue;
+        COMMAND_STATES mCommandState;
+        QueuedCommand mCurrentCommand;
+        base::Time mCommandDeadline;
+        int mPromptRetries;
+        /** Whether the driver has to restart acquisition once the queue is
+         * empty, i.e. whether the device was pinging when the command
+         * session started
+         */
+        bool mResumeAcquisition;
+
+        bool popCommand(QueuedCommand& command);
+        void sendCommand(QueuedCommand const& command);
+        void sendPromptRequest();
+        void startNextCommand();
+        void completeCommand(COMMAND_STATUS status, std::string const& reply);
+        void failCommands(COMMAND_STATUS status, std::string const& reply);
+        /** Reads a configuration reply without blocking. Returns 0 if none is
+         * available yet
+         */
+        int pollConfigurationReply();
+
     public:
         Driver();
 
@@ -33,6 +179,19 @@ namespace dvl_teledyne
          */
         void setDesiredBaudrate(int rate);
 
+        /** Selects the data format the device is asked to output when
+         * acquisition starts. The default is FORMAT_PD0
+         *
+         * The compact formats only carry the bottom tracking and part of the
+         * status, but are several times smaller than PD0 ensembles, which
+         * allows for higher ping rates on slow serial links. With them,
+         * read() only updates status, bottomTracking and outputConf.
+         *
+         * Call it before open() or startAcquisition()
+         */
+        void setOutputFormat(OUTPUT_FORMATS format);
+        OUTPUT_FORMATS getOutputFormat() const;
+
         /** Configures the output coordinate system */
         void setOutputConfiguration(OutputConfiguration conf);
         
@@ -50,19 +209,179 @@ namespace dvl_teledyne
 
         /** Start acquisition
          *
-         * Since the driver relies on receiving PD0 message frames, this method
-         * requires the DVL to send into this format, and then starts pinging
+         * This method requires the DVL to send in the format selected with
+         * setOutputFormat(), and then starts pinging
          */
         void startAcquisition();
 
-        /** Read available packets on the I/O */
+        /** Sends a batch of configuration commands (e.g. "BP001") while
+         * minimizing the interruption of the data stream
+         *
+         * All commands are sent in a single configuration mode session, each
+         * one being sent as soon as the previous one is acked. If the device
+         * was pinging, acquisition is restarted afterwards even if one of the
+         * commands failed, and the time between the last ensemble before the
+         * change and the first one after it is reported in the link
+         * statistics (see LinkStats::last_reconfiguration_gap).
+         *
+         * Throws std::runtime_error if the device rejects one of the commands.
+         * The commands after it are not sent
+         */
+        void reconfigure(std::vector<std::string> const& commands);
+
+        /** Reads and decodes the next ensemble
+         *
+         * Throws iodrivers_base::TimeoutError if no ensemble is received
+         * within the read timeout. In supervised mode, see setSupervised, it
+         * tries to recover first, and throws only if the device does not
+         * answer
+         */
         void read();
 
+        /** Reads the next packet in the output format without decoding it,
+         * for tools that only store the data stream
+         *
+         * Returns the size of the packet, which is available through
+         * getRawPacket() until the next read. Throws
+         * iodrivers_base::TimeoutError if no packet is received within
+         * \c timeout
+         */
+        int readRawPacket(base::Time const& timeout);
+        /** The packet read by the last call to readRawPacket() */
+        uint8_t const* getRawPacket() const;
+
+        /** Enables or disables the supervised mode
+         *
+         * In supervised mode, read() watches the data stream, and re-enters
+         * acquisition as soon as
+         *
+         * <ul>
+         *   <li>no ensemble is received within the stall timeout (see
+         *       setStallTimeout)
+         *   <li>the device reports a watchdog restart or a power failure in
+         *       the status word (PD0 only)
+         * </ul>
+         *
+         * Recovering only takes a break, the output format command and CS,
+         * which is much faster than a new open(). Settings that the device
+         * does not keep across restarts, such as commands sent with
+         * reconfigure() and not saved with CK, are not sent again.
+         *
+         * The stalls, restarts and times to recover are reported in the link
+         * statistics (see LinkStats::mean_time_to_recover)
+         */
+        void setSupervised(bool enable);
+        bool isSupervised() const;
+
+        /** Sets the time without ensemble after which the supervised mode
+         * considers the data stream stalled
+         *
+         * If null (the default), it is computed from the ensemble period:
+         * three times the longest of the configured duration of an ensemble
+         * (the time between ping groups times the count of water and bottom
+         * pings per ensemble) and of the last measured time between
+         * ensembles, plus the time needed to transmit one ensemble. The
+         * measured period is kept across recoveries. The read timeout is
+         * used until the period is known
+         */
+        void setStallTimeout(base::Time const& timeout);
+        /** Returns the stall timeout that read() currently uses in supervised
+         * mode
+         */
+        base::Time getStallTimeout() const;
+
+        /** Copies the last ensemble decoded by read() into \c ensemble
+         *
+         * Unlike accessing the parser fields (status, bottomTracking, ...)
+         * directly, this is safe to call from other threads while read() is
+         * running: it never blocks and always returns a consistent ensemble.
+         * Returns false if no ensemble has been read yet
+         */
+        bool getSnapshot(Ensemble& ensemble) const;
+
+        /** Count of ensembles published by read() so far */
+        uint64_t getSnapshotCount() const;
+
+        /** Makes read() publish each ensemble, along with its raw frame, in
+         * \c publisher so that other processes can access it
+         *
+         * The publisher is not owned by the driver. Set it to NULL before
+         * destroying it
+         */
+        void setSharedPublisher(SharedEnsemblePublisher* publisher);
+
+        /** Ratio between the bandwidth needed by the device and the capacity
+         * of the serial line
+         *
+         * The need is the maximum of the observed throughput and of the one
+         * predicted from the size of the last ensemble and the configured
+         * ensemble period (the time between ping groups times the count of
+         * pings per ensemble). The capacity is computed from the baud
+         * rate of the serial:// URI given to open(), or the one given to
+         * setDesiredBaudrate afterwards. Above 1, the ensembles get queued in
+         * the device, and the latency grows without bounds. See
+         * BandwidthPlanner to find a configuration that fits.
+         *
+         * The utilization is not computed, and stays 0, when the baud rate
+         * is unknown (e.g. on TCP connections)
+         */
+        float getLinkUtilization() const;
+        /** True when the link utilization is close to or above 1. A warning
+         * is printed on standard error each time the link becomes saturated
+         */
+        bool isLinkSaturated() const;
+
         /** Verifies that the DVL acked a configuration command
          *
          * Throws std::runtime_error if an error is reported by the device
          */
         void readConfigurationAck(base::Time const& timeout = base::Time::fromSeconds(1));
+
+        /** Queues a configuration command (e.g. "BP001") for asynchronous
+         * processing by processCommands()
+         *
+         * The command is given without its trailing newline. Do not queue CS
+         * commands: if the device was pinging when the commands got
+         * processed, the driver restarts acquisition by itself once the
+         * queue is empty.
+         *
+         * This method is thread-safe. The callback is called from the thread
+         * that calls processCommands()
+         */
+        void queueCommand(std::string const& command, CommandCallback const& callback);
+
+        /** Queues a configuration command and returns a future on its result
+         *
+         * See queueCommand(std::string const&, CommandCallback const&)
+         */
+        std::future<CommandResult> queueCommand(std::string const& command);
+
+        /** Advances the command state machine without blocking
+         *
+         * When there are queued commands, this sends a break to put the
+         * device in configuration mode (if it is not already), waits for the
+         * prompt, sends the commands one by one while waiting for their ack
+         * or error, and finally restarts acquisition in the format selected
+         * with setOutputFormat().
+         *
+         * It must be called regularly (e.g. on a timer of a few milliseconds
+         * or whenever the file descriptor is readable) by the thread that owns
+         * the driver, and read() must not be called while it returns true.
+         *
+         * Returns true while a command session is in progress
+         */
+        bool processCommands();
+
+        /** Whether there are commands queued or being processed. Call it
+         * from the thread that calls processCommands()
+         */
+        bool hasPendingCommands() const;
+
+        /** Removes all queued commands that have not been sent yet. Their
+         * callbacks are called with COMMAND_CANCELLED. The command being
+         * processed, if any, is not affected
+         */
+        void cancelCommands();
     };
 }
 
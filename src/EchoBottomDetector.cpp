@@ -0,0 +1,321 @@
+#include <dvl_teledyne/EchoBottomDetector.hpp>
+#include <base/Float.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace dvl_teledyne;
+
+namespace
+{
+    /** Per-beam results of the passes over the cells. Cell indexes are
+     * stored as floats so that they can share SSE registers with the
+     * intensities
+     */
+    struct Profile
+    {
+        float peak[4];
+        float peak_index[4];
+        /** Mean of the valid cells of the search window */
+        float mean[4];
+        /** Last cell below the edge level before the peak, -1 if there is
+         * none
+         */
+        float near_edge[4];
+        /** First cell below the edge level after the peak, or the count of
+         * cells if there is none
+         */
+        float far_edge[4];
+        /** Mean of the valid cells outside of the edges */
+        float background[4];
+        float background_count[4];
+    };
+
+    float intensityAt(CellReadings const& readings, int cell, int beam)
+    {
+        return readings.readings[cell].intensity[beam];
+    }
+
+#ifdef __SSE2__
+    __m128 select(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    __m128 loadIntensity(CellReadings const& readings, size_t cell)
+    {
+        return _mm_loadu_ps(readings.readings[cell].intensity);
+    }
+
+    /** Finds the peak and the mean of the intensity */
+    void findPeak(CellReadings const& readings, size_t first, Profile& profile)
+    {
+        __m128 const one = _mm_set1_ps(1);
+        __m128 peak = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        __m128 peak_index = _mm_set1_ps(-1);
+        __m128 sum   = _mm_setzero_ps();
+        __m128 count = _mm_setzero_ps();
+        __m128 index = _mm_set1_ps(first);
+        for (size_t cell = first; cell < readings.readings.size(); ++cell)
+        {
+            __m128 value = loadIntensity(readings, cell);
+            __m128 valid = _mm_cmpord_ps(value, value);
+            sum   = _mm_add_ps(sum, _mm_and_ps(valid, value));
+            count = _mm_add_ps(count, _mm_and_ps(valid, one));
+            // Comparisons with NaN are false, unknown cells are never a peak
+            __m128 higher = _mm_cmpgt_ps(value, peak);
+            peak       = select(higher, value, peak);
+            peak_index = select(higher, index, peak_index);
+            index = _mm_add_ps(index, one);
+        }
+        _mm_storeu_ps(profile.peak, peak);
+        _mm_storeu_ps(profile.peak_index, peak_index);
+        _mm_storeu_ps(profile.mean, _mm_div_ps(sum, _mm_max_ps(count, one)));
+    }
+
+    /** Finds the cells below \c level that are closest to the peak on both
+     * sides
+     */
+    void findEdges(CellReadings const& readings, size_t first, float const* level, Profile& profile)
+    {
+        __m128 const one = _mm_set1_ps(1);
+        __m128 const threshold  = _mm_loadu_ps(level);
+        __m128 const peak_index = _mm_loadu_ps(profile.peak_index);
+        __m128 near_edge = _mm_set1_ps(-1);
+        __m128 far_edge  = _mm_set1_ps(readings.readings.size());
+        __m128 index = _mm_set1_ps(first);
+        for (size_t cell = first; cell < readings.readings.size(); ++cell)
+        {
+            __m128 below = _mm_cmplt_ps(loadIntensity(readings, cell), threshold);
+            __m128 near_below = _mm_and_ps(below, _mm_cmplt_ps(index, peak_index));
+            __m128 far_below  = _mm_and_ps(below, _mm_cmpgt_ps(index, peak_index));
+            near_edge = _mm_max_ps(near_edge, select(near_below, index, near_edge));
+            far_edge  = _mm_min_ps(far_edge,  select(far_below, index, far_edge));
+            index = _mm_add_ps(index, one);
+        }
+        _mm_storeu_ps(profile.near_edge, near_edge);
+        _mm_storeu_ps(profile.far_edge, far_edge);
+    }
+
+    /** Computes the mean of the intensity outside of the edges */
+    void findBackground(CellReadings const& readings, size_t first, Profile& profile)
+    {
+        __m128 const one = _mm_set1_ps(1);
+        __m128 const near_edge = _mm_loadu_ps(profile.near_edge);
+        __m128 const far_edge  = _mm_loadu_ps(profile.far_edge);
+        __m128 sum   = _mm_setzero_ps();
+        __m128 count = _mm_setzero_ps();
+        __m128 index = _mm_set1_ps(first);
+        for (size_t cell = first; cell < readings.readings.size(); ++cell)
+        {
+            __m128 value = loadIntensity(readings, cell);
+            __m128 outside = _mm_or_ps(_mm_cmple_ps(index, near_edge), _mm_cmpge_ps(index, far_edge));
+            __m128 mask = _mm_and_ps(outside, _mm_cmpord_ps(value, value));
+            sum   = _mm_add_ps(sum, _mm_and_ps(mask, value));
+            count = _mm_add_ps(count, _mm_and_ps(mask, one));
+            index = _mm_add_ps(index, one);
+        }
+        _mm_storeu_ps(profile.background, _mm_div_ps(sum, _mm_max_ps(count, one)));
+        _mm_storeu_ps(profile.background_count, count);
+    }
+#else
+    void findPeak(CellReadings const& readings, size_t first, Profile& profile)
+    {
+        for (int beam = 0; beam < 4; ++beam)
+        {
+            float peak = -std::numeric_limits<float>::infinity();
+            float peak_index = -1;
+            float sum = 0;
+            int count = 0;
+            for (size_t cell = first; cell < readings.readings.size(); ++cell)
+            {
+                float value = intensityAt(readings, cell, beam);
+                if (base::isNaN(value))
+                    continue;
+                sum += value;
+                count++;
+                if (value > peak)
+                {
+                    peak = value;
+                    peak_index = cell;
+                }
+            }
+            profile.peak[beam] = peak;
+            profile.peak_index[beam] = peak_index;
+            profile.mean[beam] = sum / std::max(count, 1);
+        }
+    }
+
+    void findEdges(CellReadings const& readings, size_t first, float const* level, Profile& profile)
+    {
+        for (int beam = 0; beam < 4; ++beam)
+        {
+            float near_edge = -1;
+            float far_edge = readings.readings.size();
+            for (size_t cell = first; cell < readings.readings.size(); ++cell)
+            {
+                if (!(intensityAt(readings, cell, beam) < level[beam]))
+                    continue;
+                if (cell < profile.peak_index[beam])
+                    near_edge = cell;
+                else if (cell > profile.peak_index[beam])
+                {
+                    far_edge = cell;
+                    break;
+                }
+            }
+            profile.near_edge[beam] = near_edge;
+            profile.far_edge[beam] = far_edge;
+        }
+    }
+
+    void findBackground(CellReadings const& readings, size_t first, Profile& profile)
+    {
+        for (int beam = 0; beam < 4; ++beam)
+        {
+            float sum = 0;
+            int count = 0;
+            for (size_t cell = first; cell < readings.readings.size(); ++cell)
+            {
+                float value = intensityAt(readings, cell, beam);
+                if (base::isNaN(value))
+                    continue;
+                if (cell <= profile.near_edge[beam] || cell >= profile.far_edge[beam])
+                {
+                    sum += value;
+                    count++;
+                }
+            }
+            profile.background[beam] = sum / std::max(count, 1);
+            profile.background_count[beam] = count;
+        }
+    }
+#endif
+
+    /** Position, in cells, at which the intensity crosses \c level between
+     * \c outer and the next cell towards the peak
+     */
+    float interpolateEdge(CellReadings const& readings, int outer, int direction, int beam, float level)
+    {
+        float outer_value = intensityAt(readings, outer, beam);
+        float inner_value = intensityAt(readings, outer + direction, beam);
+        if (base::isNaN(inner_value) || inner_value <= outer_value)
+            return outer;
+        return outer + direction * (level - outer_value) / (inner_value - outer_value);
+    }
+
+    /** Sub-cell position of the peak, from a parabola through the peak and
+     * its two neighbours
+     */
+    float interpolatePeak(CellReadings const& readings, size_t first, int peak, int beam)
+    {
+        if (peak <= static_cast<int>(first) || peak + 1 >= static_cast<int>(readings.readings.size()))
+            return peak;
+
+        float before = intensityAt(readings, peak - 1, beam);
+        float at     = intensityAt(readings, peak, beam);
+        float after  = intensityAt(readings, peak + 1, beam);
+        float curvature = before - 2 * at + after;
+        if (base::isNaN(curvature) || curvature >= 0)
+            return peak;
+        float offset = 0.5 * (before - after) / curvature;
+        return peak + std::max(-0.5f, std::min(0.5f, offset));
+    }
+}
+
+EchoBottomConfiguration::EchoBottomConfiguration()
+    : min_range(0)
+    , edge_level(0.5)
+    , min_contrast(6)
+    , full_contrast(20)
+{
+}
+
+EchoBottomDetector::EchoBottomDetector(EchoBottomConfiguration const& conf)
+{
+    setConfiguration(conf);
+}
+
+void EchoBottomDetector::setConfiguration(EchoBottomConfiguration const& conf)
+{
+    if (conf.edge_level <= 0 || conf.edge_level >= 1)
+        throw std::invalid_argument("EchoBottomDetector: edge_level must be strictly between 0 and 1");
+    if (conf.full_contrast <= conf.min_contrast)
+        throw std::invalid_argument("EchoBottomDetector: full_contrast must be greater than min_contrast");
+    mConfiguration = conf;
+}
+
+EchoBottomConfiguration const& EchoBottomDetector::getConfiguration() const
+{
+    return mConfiguration;
+}
+
+EchoBottom EchoBottomDetector::detect(CellReadings const& readings, AcquisitionConfiguration const& conf) const
+{
+    EchoBottom result;
+    result.time = readings.time;
+    for (int beam = 0; beam < 4; ++beam)
+    {
+        result.range[beam]      = base::unknown<float>();
+        result.confidence[beam] = 0;
+        result.intensity[beam]  = base::unknown<float>();
+    }
+
+    size_t cell_count = readings.readings.size();
+    if (conf.cell_length <= 0 || cell_count < 3)
+        return result;
+
+    size_t first = 0;
+    if (mConfiguration.min_range > conf.first_cell_distance)
+        first = std::ceil((mConfiguration.min_range - conf.first_cell_distance) / conf.cell_length);
+    if (first + 3 > cell_count)
+        return result;
+
+    Profile profile;
+    findPeak(readings, first, profile);
+
+    float level[4];
+    for (int beam = 0; beam < 4; ++beam)
+        level[beam] = profile.mean[beam] + mConfiguration.edge_level * (profile.peak[beam] - profile.mean[beam]);
+    findEdges(readings, first, level, profile);
+    findBackground(readings, first, profile);
+
+    float expected_width = std::max(1.0f, conf.transmit_pulse_length / conf.cell_length);
+    for (int beam = 0; beam < 4; ++beam)
+    {
+        // A peak without a rising edge in the search window cannot be told
+        // apart from the decay of the water column or from the ringing
+        int peak = profile.peak_index[beam];
+        int near_edge = profile.near_edge[beam];
+        if (peak < 0 || near_edge < 0)
+            continue;
+
+        float background = profile.background_count[beam] ? profile.background[beam] : profile.mean[beam];
+        float contrast = profile.peak[beam] - background;
+        if (contrast < mConfiguration.min_contrast)
+            continue;
+
+        // Width of the echo at the edge level. If the echo extends past the
+        // search window, it is assumed symmetric
+        float position = interpolatePeak(readings, first, peak, beam);
+        float near_position = interpolateEdge(readings, near_edge, 1, beam, level[beam]);
+        int far_edge = profile.far_edge[beam];
+        float width;
+        if (far_edge < static_cast<int>(cell_count))
+            width = interpolateEdge(readings, far_edge, -1, beam, level[beam]) - near_position;
+        else
+            width = 2 * (position - near_position);
+
+        float contrast_ratio = (contrast - mConfiguration.min_contrast) /
+            (mConfiguration.full_contrast - mConfiguration.min_contrast);
+        float sharpness = expected_width / std::max(width, expected_width);
+        result.range[beam]      = conf.first_cell_distance + position * conf.cell_length;
+        result.confidence[beam] = std::min(1.0f, contrast_ratio) * sharpness;
+        result.intensity[beam]  = profile.peak[beam];
+    }
+    return result;
+}
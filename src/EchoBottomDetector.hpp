@@ -0,0 +1,86 @@
+#ifndef DVL_TELEDYNE_ECHOBOTTOMDETECTOR_HPP
+#define DVL_TELEDYNE_ECHOBOTTOMDETECTOR_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+
+namespace dvl_teledyne
+{
+    /** Configuration of EchoBottomDetector */
+    struct EchoBottomConfiguration
+    {
+        /** Cells closer than this distance (in meters) are not searched.
+         * Use it to skip the cells that are saturated by the transducer
+         * ringing
+         */
+        float min_range;
+        /** Level at which the edges of the echo are detected, as a ratio
+         * between the background (0) and the peak (1)
+         */
+        float edge_level;
+        /** Minimum difference, in dB, between the peak and the background
+         * for an echo to be reported
+         */
+        float min_contrast;
+        /** Difference, in dB, between the peak and the background above which
+         * the contrast does not lower the confidence anymore
+         */
+        float full_contrast;
+
+        EchoBottomConfiguration();
+    };
+
+    /** Bottom range estimated from the depth cell intensities */
+    struct EchoBottom
+    {
+        /** Acquisition timestamp */
+        base::Time time;
+        /** Vertical range to the bottom for each beam, in meters. Unknown if
+         * no echo has been found on the beam
+         */
+        float range[4];
+        /** Confidence in the range, between 0 and 1 */
+        float confidence[4];
+        /** Intensity at the peak of the echo, in dB */
+        float intensity[4];
+    };
+
+    /** Detection of the bottom echo in the depth cell intensities
+     *
+     * This is meant as a backup when bottom tracking loses lock: the bottom
+     * often still shows as a clear peak in the intensity profile. For each
+     * beam, the detector finds the maximum intensity beyond min_range, the
+     * edges of the echo around it and the background level outside of the
+     * edges. Echoes whose rising edge is not within the search window are
+     * not reported. The range is the interpolated position of the peak. The
+     * confidence is the product of the contrast between the peak and the
+     * background and of the sharpness of the echo, i.e. the ratio between
+     * the expected echo width (the cell or the transmitted pulse, whichever
+     * is longer) and the measured one.
+     *
+     * The four beams of a cell are contiguous in CellReadings, which lets
+     * SSE process them in parallel. The cost is three passes over the cells.
+     */
+    class EchoBottomDetector
+    {
+    public:
+        EchoBottomDetector(EchoBottomConfiguration const& conf = EchoBottomConfiguration());
+
+        void setConfiguration(EchoBottomConfiguration const& conf);
+        EchoBottomConfiguration const& getConfiguration() const;
+
+        /** Detects the bottom echo in \c readings
+         *
+         * The cell geometry is taken from \c conf, i.e. the
+         * AcquisitionConfiguration decoded along with the readings. Since the
+         * depth cells are vertical, so is the range, as for the bottom
+         * tracking ranges.
+         */
+        EchoBottom detect(CellReadings const& readings, AcquisitionConfiguration const& conf) const;
+
+    private:
+        EchoBottomConfiguration mConfiguration;
+    };
+}
+
+#endif
+
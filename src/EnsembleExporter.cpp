@@ -0,0 +1,545 @@
+#include <dvl_teledyne/EnsembleExporter.hpp>
+#include <dvl_teledyne/PD0Parser.hpp>
+#include <base/Float.hpp>
+#include <endian.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmath>
+#include <stdexcept>
+
+using namespace dvl_teledyne;
+
+namespace
+{
+    /** Exported float fields of Status, besides the attitude */
+    struct StatusColumn
+    {
+        char const* name;
+        float Status::*field;
+        int decimals;
+    };
+
+    static const StatusColumn STATUS_COLUMNS[] = {
+        { "depth",          &Status::depth,          1 },
+        { "speed_of_sound", &Status::speed_of_sound, 1 },
+        { "salinity",       &Status::salinity,       3 },
+        { "temperature",    &Status::temperature,    2 },
+        { "pressure",       &Status::pressure,       0 }
+    };
+    static const int STATUS_COLUMN_COUNT = sizeof(STATUS_COLUMNS) / sizeof(STATUS_COLUMNS[0]);
+    /** Resolution of the PD0 attitude is 0.01 degrees */
+    static const int ANGLE_DECIMALS = 5;
+    static char const* ANGLE_NAMES[3] = { "yaw", "pitch", "roll" };
+
+    /** Exported per-beam fields of BottomTracking */
+    struct BeamColumn
+    {
+        char const* name;
+        float (BottomTracking::*field)[4];
+        int decimals;
+    };
+
+    static const BeamColumn BEAM_COLUMNS[] = {
+        { "bottom_range",           &BottomTracking::range,           2 },
+        { "bottom_velocity",        &BottomTracking::velocity,        3 },
+        { "bottom_correlation",     &BottomTracking::correlation,     3 },
+        { "bottom_evaluation",      &BottomTracking::evaluation,      3 },
+        { "bottom_good_ping_ratio", &BottomTracking::good_ping_ratio, 3 },
+        { "bottom_rssi",            &BottomTracking::rssi,            2 }
+    };
+    static const int BEAM_COLUMN_COUNT = sizeof(BEAM_COLUMNS) / sizeof(BEAM_COLUMNS[0]);
+
+    /** Exported fields of CellReading */
+    struct CellColumn
+    {
+        EXPORT_FIELDS group;
+        char const* name;
+        float (CellReading::*field)[4];
+        int decimals;
+    };
+
+    static const CellColumn CELL_COLUMNS[] = {
+        { EXPORT_CELL_VELOCITY,    "cell_velocity",    &CellReading::velocity,    3 },
+        { EXPORT_CELL_CORRELATION, "cell_correlation", &CellReading::correlation, 3 },
+        { EXPORT_CELL_INTENSITY,   "cell_intensity",   &CellReading::intensity,   2 },
+        { EXPORT_CELL_QUALITY,     "cell_quality",     &CellReading::quality,     3 }
+    };
+    static const int CELL_COLUMN_COUNT = sizeof(CELL_COLUMNS) / sizeof(CELL_COLUMNS[0]);
+
+    static const int64_t POWERS_OF_TEN[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+    /** Largest buffer needed by appendFloat and appendInteger */
+    static const size_t MAX_NUMBER_SIZE = 32;
+
+    /** Yaw, pitch and roll of an orientation built as in PD0Fields, i.e.
+     * roll around X, then pitch around Y, then yaw around Z
+     */
+    void toAngles(base::Quaterniond const& orientation, float* angles)
+    {
+        Eigen::Matrix3d m = orientation.toRotationMatrix();
+        angles[0] = atan2(-m(0, 1), m(0, 0));
+        angles[1] = asin(std::max(-1.0, std::min(1.0, m(0, 2))));
+        angles[2] = atan2(-m(1, 2), m(2, 2));
+    }
+
+    /** Writes the decimal digits of \c value at \c out, returns the end */
+    char* writeDigits(char* out, uint64_t value)
+    {
+        char digits[20];
+        int count = 0;
+        do
+        {
+            digits[count++] = '0' + value % 10;
+            value /= 10;
+        }
+        while (value);
+
+        while (count)
+            *out++ = digits[--count];
+        return out;
+    }
+
+    int cellQuantityCount(int fields)
+    {
+        int result = 0;
+        for (int i = 0; i < CELL_COLUMN_COUNT; ++i)
+            result += (fields & CELL_COLUMNS[i].group) ? 1 : 0;
+        return result;
+    }
+}
+
+EnsembleExporter::EnsembleExporter(int fd, EXPORT_FORMATS format, int fields, size_t buffer_size)
+    : mFd(fd)
+    , mFormat(format)
+    , mFields(fields)
+    , mBuffer(std::max<size_t>(buffer_size, 4096))
+    , mUsed(0)
+    , mHeaderCellCount(-1)
+    , mEnsembleCount(0)
+    , mBytesWritten(0)
+{
+}
+
+EnsembleExporter::~EnsembleExporter()
+{
+    try { flush(); }
+    catch(std::runtime_error const&) {}
+}
+
+int EnsembleExporter::parseFields(std::string const& names)
+{
+    int result = 0;
+    size_t start = 0;
+    while (start <= names.size())
+    {
+        size_t end = names.find(',', start);
+        if (end == std::string::npos)
+            end = names.size();
+        std::string name = names.substr(start, end - start);
+        if (name == "status")
+            result |= EXPORT_STATUS;
+        else if (name == "bottom")
+            result |= EXPORT_BOTTOM_TRACKING;
+        else if (name == "velocity")
+            result |= EXPORT_CELL_VELOCITY;
+        else if (name == "correlation")
+            result |= EXPORT_CELL_CORRELATION;
+        else if (name == "intensity")
+            result |= EXPORT_CELL_INTENSITY;
+        else if (name == "quality")
+            result |= EXPORT_CELL_QUALITY;
+        else if (name == "cells")
+            result |= EXPORT_CELL_VELOCITY | EXPORT_CELL_CORRELATION |
+                EXPORT_CELL_INTENSITY | EXPORT_CELL_QUALITY;
+        else
+            throw std::invalid_argument("unknown field group '" + name + "'");
+        start = end + 1;
+    }
+    return result;
+}
+
+void EnsembleExporter::flush()
+{
+    size_t written = 0;
+    while (written < mUsed)
+    {
+        ssize_t result = ::write(mFd, &mBuffer[written], mUsed - written);
+        if (result == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            // Drop the buffer, so that the destructor does not retry
+            mUsed = 0;
+            throw std::runtime_error(std::string("cannot write exported data: ") + strerror(errno));
+        }
+        written += result;
+        mBytesWritten += result;
+    }
+    mUsed = 0;
+}
+
+char* EnsembleExporter::reserve(size_t size)
+{
+    if (mUsed + size > mBuffer.size())
+        flush();
+    return &mBuffer[mUsed];
+}
+
+void EnsembleExporter::append(char const* data, size_t size)
+{
+    if (mUsed + size > mBuffer.size())
+    {
+        flush();
+        if (size > mBuffer.size())
+        {
+            // Too large for the buffer, write it directly
+            std::copy(data, data + mBuffer.size(), mBuffer.begin());
+            mUsed = mBuffer.size();
+            flush();
+            append(data + mBuffer.size(), size - mBuffer.size());
+            return;
+        }
+    }
+    memcpy(&mBuffer[mUsed], data, size);
+    mUsed += size;
+}
+
+void EnsembleExporter::append(char const* text)
+{
+    append(text, strlen(text));
+}
+
+void EnsembleExporter::appendInteger(int64_t value)
+{
+    char* out = reserve(MAX_NUMBER_SIZE);
+    char* end = out;
+    if (value < 0)
+    {
+        *end++ = '-';
+        end = writeDigits(end, -static_cast<uint64_t>(value));
+    }
+    else
+        end = writeDigits(end, value);
+    mUsed += end - out;
+}
+
+void EnsembleExporter::appendFloat(float value, int decimals)
+{
+    if (base::isNaN(value) || std::isinf(value))
+    {
+        if (mFormat == EXPORT_JSONL)
+            append("null", 4);
+        return;
+    }
+
+    double scaled = value * POWERS_OF_TEN[decimals];
+    if (!(std::fabs(scaled) < 1e15))
+    {
+        // Too large for the fixed point formatting
+        char* out = reserve(MAX_NUMBER_SIZE);
+        mUsed += snprintf(out, MAX_NUMBER_SIZE, "%.9g", value);
+        return;
+    }
+
+    char* out = reserve(MAX_NUMBER_SIZE);
+    char* end = out;
+    int64_t fixed = llround(scaled);
+    if (fixed < 0)
+    {
+        *end++ = '-';
+        fixed = -fixed;
+    }
+    end = writeDigits(end, fixed / POWERS_OF_TEN[decimals]);
+    if (decimals)
+    {
+        *end++ = '.';
+        int64_t fraction = fixed % POWERS_OF_TEN[decimals];
+        for (int i = decimals - 1; i >= 0; --i)
+        {
+            end[i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        end += decimals;
+    }
+    mUsed += end - out;
+}
+
+void EnsembleExporter::appendBinary(uint32_t value)
+{
+    value = htole32(value);
+    append(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+void EnsembleExporter::appendBinary(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    appendBinary(bits);
+}
+
+void EnsembleExporter::write(PD0Parser const& parser)
+{
+    writeImpl(parser);
+}
+
+void EnsembleExporter::write(Ensemble const& ensemble)
+{
+    writeImpl(ensemble);
+}
+
+template<typename Source>
+void EnsembleExporter::writeImpl(Source const& source)
+{
+    if (mFormat == EXPORT_CSV)
+        writeCSV(source.status, source.bottomTracking, source.cellReadings);
+    else if (mFormat == EXPORT_JSONL)
+        writeJSON(source.status, source.bottomTracking, source.cellReadings);
+    else
+        writeBinary(source.status, source.bottomTracking, source.cellReadings);
+    mEnsembleCount++;
+}
+
+void EnsembleExporter::writeCSVHeader(size_t cell_count)
+{
+    bool first = true;
+    char name[64];
+    if (mFields & EXPORT_STATUS)
+    {
+        append("time,seq");
+        for (int i = 0; i < STATUS_COLUMN_COUNT; ++i)
+        {
+            append(",", 1);
+            append(STATUS_COLUMNS[i].name);
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            append(",", 1);
+            append(ANGLE_NAMES[i]);
+        }
+        first = false;
+    }
+    if (mFields & EXPORT_BOTTOM_TRACKING)
+    {
+        for (int i = 0; i < BEAM_COLUMN_COUNT; ++i)
+        {
+            for (int beam = 0; beam < 4; ++beam)
+            {
+                if (!first)
+                    append(",", 1);
+                append(name, snprintf(name, sizeof(name), "%s_%d", BEAM_COLUMNS[i].name, beam));
+                first = false;
+            }
+        }
+    }
+    for (int i = 0; i < CELL_COLUMN_COUNT; ++i)
+    {
+        if (!(mFields & CELL_COLUMNS[i].group))
+            continue;
+        for (size_t cell = 0; cell < cell_count; ++cell)
+        {
+            for (int beam = 0; beam < 4; ++beam)
+            {
+                if (!first)
+                    append(",", 1);
+                append(name, snprintf(name, sizeof(name), "%s_%d_%d",
+                            CELL_COLUMNS[i].name, static_cast<int>(cell), beam));
+                first = false;
+            }
+        }
+    }
+    append("\n", 1);
+    mHeaderCellCount = cell_count;
+}
+
+void EnsembleExporter::writeCSV(Status const& status, BottomTracking const& tracking, CellReadings const& cells)
+{
+    size_t cell_count = cells.readings.size();
+    if (mHeaderCellCount != static_cast<int>(cell_count) &&
+            (mHeaderCellCount == -1 || cellQuantityCount(mFields)))
+        writeCSVHeader(cell_count);
+
+    bool first = true;
+    if (mFields & EXPORT_STATUS)
+    {
+        appendInteger(status.time.toMicroseconds());
+        append(",", 1);
+        appendInteger(status.seq);
+        for (int i = 0; i < STATUS_COLUMN_COUNT; ++i)
+        {
+            append(",", 1);
+            appendFloat(status.*STATUS_COLUMNS[i].field, STATUS_COLUMNS[i].decimals);
+        }
+        float angles[3];
+        toAngles(status.orientation, angles);
+        for (int i = 0; i < 3; ++i)
+        {
+            append(",", 1);
+            appendFloat(angles[i], ANGLE_DECIMALS);
+        }
+        first = false;
+    }
+    if (mFields & EXPORT_BOTTOM_TRACKING)
+    {
+        for (int i = 0; i < BEAM_COLUMN_COUNT; ++i)
+        {
+            float const* values = tracking.*BEAM_COLUMNS[i].field;
+            for (int beam = 0; beam < 4; ++beam)
+            {
+                if (!first)
+                    append(",", 1);
+                appendFloat(values[beam], BEAM_COLUMNS[i].decimals);
+                first = false;
+            }
+        }
+    }
+    for (int i = 0; i < CELL_COLUMN_COUNT; ++i)
+    {
+        if (!(mFields & CELL_COLUMNS[i].group))
+            continue;
+        for (size_t cell = 0; cell < cell_count; ++cell)
+        {
+            float const* values = cells.readings[cell].*CELL_COLUMNS[i].field;
+            for (int beam = 0; beam < 4; ++beam)
+            {
+                if (!first)
+                    append(",", 1);
+                appendFloat(values[beam], CELL_COLUMNS[i].decimals);
+                first = false;
+            }
+        }
+    }
+    append("\n", 1);
+}
+
+void EnsembleExporter::writeJSON(Status const& status, BottomTracking const& tracking, CellReadings const& cells)
+{
+    char const* separator = "{";
+    if (mFields & EXPORT_STATUS)
+    {
+        append("{\"time\":");
+        appendInteger(status.time.toMicroseconds());
+        append(",\"seq\":");
+        appendInteger(status.seq);
+        for (int i = 0; i < STATUS_COLUMN_COUNT; ++i)
+        {
+            append(",\"");
+            append(STATUS_COLUMNS[i].name);
+            append("\":");
+            appendFloat(status.*STATUS_COLUMNS[i].field, STATUS_COLUMNS[i].decimals);
+        }
+        float angles[3];
+        toAngles(status.orientation, angles);
+        for (int i = 0; i < 3; ++i)
+        {
+            append(",\"");
+            append(ANGLE_NAMES[i]);
+            append("\":");
+            appendFloat(angles[i], ANGLE_DECIMALS);
+        }
+        separator = ",";
+    }
+    if (mFields & EXPORT_BOTTOM_TRACKING)
+    {
+        for (int i = 0; i < BEAM_COLUMN_COUNT; ++i)
+        {
+            append(separator);
+            append("\"");
+            append(BEAM_COLUMNS[i].name);
+            append("\":[");
+            float const* values = tracking.*BEAM_COLUMNS[i].field;
+            for (int beam = 0; beam < 4; ++beam)
+            {
+                if (beam)
+                    append(",", 1);
+                appendFloat(values[beam], BEAM_COLUMNS[i].decimals);
+            }
+            append("]", 1);
+            separator = ",";
+        }
+    }
+    for (int i = 0; i < CELL_COLUMN_COUNT; ++i)
+    {
+        if (!(mFields & CELL_COLUMNS[i].group))
+            continue;
+        append(separator);
+        append("\"");
+        append(CELL_COLUMNS[i].name);
+        append("\":[");
+        for (size_t cell = 0; cell < cells.readings.size(); ++cell)
+        {
+            append(cell ? ",[" : "[");
+            float const* values = cells.readings[cell].*CELL_COLUMNS[i].field;
+            for (int beam = 0; beam < 4; ++beam)
+            {
+                if (beam)
+                    append(",", 1);
+                appendFloat(values[beam], CELL_COLUMNS[i].decimals);
+            }
+            append("]", 1);
+        }
+        append("]", 1);
+        separator = ",";
+    }
+    if (*separator == '{')
+        append("{", 1);
+    append("}\n", 2);
+}
+
+void EnsembleExporter::writeBinary(Status const& status, BottomTracking const& tracking, CellReadings const& cells)
+{
+    size_t cell_count = cells.readings.size();
+    uint32_t size = 8;
+    if (mFields & EXPORT_STATUS)
+        size += 12 + 4 * (STATUS_COLUMN_COUNT + 3);
+    if (mFields & EXPORT_BOTTOM_TRACKING)
+        size += 4 * 4 * BEAM_COLUMN_COUNT;
+    size += 4 * 4 * cell_count * cellQuantityCount(mFields);
+
+    appendBinary(size);
+    appendBinary(static_cast<uint32_t>(mFields & 0xffff) | static_cast<uint32_t>(cell_count << 16));
+    if (mFields & EXPORT_STATUS)
+    {
+        uint64_t time = status.time.toMicroseconds();
+        appendBinary(static_cast<uint32_t>(time));
+        appendBinary(static_cast<uint32_t>(time >> 32));
+        appendBinary(status.seq);
+        for (int i = 0; i < STATUS_COLUMN_COUNT; ++i)
+            appendBinary(status.*STATUS_COLUMNS[i].field);
+        float angles[3];
+        toAngles(status.orientation, angles);
+        for (int i = 0; i < 3; ++i)
+            appendBinary(angles[i]);
+    }
+    if (mFields & EXPORT_BOTTOM_TRACKING)
+    {
+        for (int i = 0; i < BEAM_COLUMN_COUNT; ++i)
+        {
+            float const* values = tracking.*BEAM_COLUMNS[i].field;
+            for (int beam = 0; beam < 4; ++beam)
+                appendBinary(values[beam]);
+        }
+    }
+    for (int i = 0; i < CELL_COLUMN_COUNT; ++i)
+    {
+        if (!(mFields & CELL_COLUMNS[i].group))
+            continue;
+        for (size_t cell = 0; cell < cell_count; ++cell)
+        {
+            float const* values = cells.readings[cell].*CELL_COLUMNS[i].field;
+            for (int beam = 0; beam < 4; ++beam)
+                appendBinary(values[beam]);
+        }
+    }
+}
+
+uint64_t EnsembleExporter::getEnsembleCount() const
+{
+    return mEnsembleCount;
+}
+
+uint64_t EnsembleExporter::getBytesWritten() const
+{
+    return mBytesWritten;
+}
@@ -0,0 +1,138 @@
+#ifndef DVL_TELEDYNE_ENSEMBLEEXPORTER_HPP
+#define DVL_TELEDYNE_ENSEMBLEEXPORTER_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+#include <string>
+#include <vector>
+
+namespace dvl_teledyne
+{
+    class PD0Parser;
+
+    enum EXPORT_FORMATS
+    {
+        /** Comma-separated values, with a header line. The header is written
+         * again whenever the count of cells changes
+         */
+        EXPORT_CSV,
+        /** One JSON object per line. Per-beam values are arrays of 4, cell
+         * values arrays of cells
+         */
+        EXPORT_JSONL,
+        /** Little-endian binary records, see EnsembleExporter */
+        EXPORT_BINARY
+    };
+
+    /** Groups of fields that can be exported, to be combined with | */
+    enum EXPORT_FIELDS
+    {
+        /** Time, sequence number, depth, speed of sound, salinity,
+         * temperature, pressure, yaw, pitch and roll
+         */
+        EXPORT_STATUS           = 0x01,
+        /** Bottom range, velocity, correlation, evaluation, good ping ratio
+         * and RSSI of each beam
+         */
+        EXPORT_BOTTOM_TRACKING  = 0x02,
+        EXPORT_CELL_VELOCITY    = 0x04,
+        EXPORT_CELL_CORRELATION = 0x08,
+        EXPORT_CELL_INTENSITY   = 0x10,
+        EXPORT_CELL_QUALITY     = 0x20
+    };
+
+    /** Writes ensembles to a file descriptor, in a format meant to be piped
+     * into analysis tools
+     *
+     * The output is accumulated in a buffer and written only when the buffer
+     * is full, or on flush(). Floats are formatted in fixed point, with as
+     * many decimals as the resolution of the PD0 fields requires, without
+     * going through the C library. Unknown values are written as an empty
+     * CSV field, as null in JSON and as NaN in binary records.
+     *
+     * Times are in microseconds since the epoch, angles in radians, and the
+     * other values in the units of the decoded structures.
+     *
+     * A binary record is made of:
+     * <ul>
+     * <li>the size of the record in bytes, including this field (uint32)
+     * <li>the exported fields, as a combination of EXPORT_FIELDS (uint16)
+     * <li>the count of cells (uint16)
+     * <li>if EXPORT_STATUS is set, the time (int64), the sequence number
+     *     (uint32), and the depth, speed of sound, salinity, temperature,
+     *     pressure, yaw, pitch and roll (8 floats)
+     * <li>if EXPORT_BOTTOM_TRACKING is set, the range, velocity, correlation,
+     *     evaluation, good ping ratio and RSSI of the four beams (24 floats)
+     * <li>for each selected cell quantity, in the order of EXPORT_FIELDS,
+     *     the four values of each cell (4 floats per cell)
+     * </ul>
+     */
+    class EnsembleExporter
+    {
+    public:
+        /** Creates an exporter that writes to \c fd. The file descriptor is
+         * not closed by the exporter
+         */
+        EnsembleExporter(int fd, EXPORT_FORMATS format, int fields,
+                size_t buffer_size = 1 << 20);
+        /** Flushes the buffer */
+        ~EnsembleExporter();
+
+        /** Exports the ensemble just decoded by \c parser
+         *
+         * Throws std::runtime_error if the buffer needs to be written and
+         * the write fails
+         */
+        void write(PD0Parser const& parser);
+        /** Exports \c ensemble */
+        void write(Ensemble const& ensemble);
+
+        /** Writes the buffer to the file descriptor */
+        void flush();
+
+        /** Count of ensembles exported so far */
+        uint64_t getEnsembleCount() const;
+        /** Count of bytes written to the file descriptor so far */
+        uint64_t getBytesWritten() const;
+
+        /** Parses a comma-separated list of field groups (status, bottom,
+         * velocity, correlation, intensity, quality, cells) into a
+         * combination of EXPORT_FIELDS. "cells" selects all cell quantities
+         *
+         * Throws std::invalid_argument on unknown names
+         */
+        static int parseFields(std::string const& names);
+
+    private:
+        int mFd;
+        EXPORT_FORMATS mFormat;
+        int mFields;
+        std::vector<char> mBuffer;
+        size_t mUsed;
+        /** Count of cells in the last CSV header, -1 before the first one */
+        int mHeaderCellCount;
+        uint64_t mEnsembleCount;
+        uint64_t mBytesWritten;
+
+        EnsembleExporter(EnsembleExporter const&);
+        EnsembleExporter& operator =(EnsembleExporter const&);
+
+        /** Makes sure that \c size bytes can be appended */
+        char* reserve(size_t size);
+        void append(char const* data, size_t size);
+        void append(char const* text);
+        void appendFloat(float value, int decimals);
+        void appendInteger(int64_t value);
+        void appendBinary(uint32_t value);
+        void appendBinary(float value);
+
+        template<typename Source>
+        void writeImpl(Source const& source);
+        void writeCSVHeader(size_t cell_count);
+        void writeCSV(Status const& status, BottomTracking const& tracking, CellReadings const& cells);
+        void writeJSON(Status const& status, BottomTracking const& tracking, CellReadings const& cells);
+        void writeBinary(Status const& status, BottomTracking const& tracking, CellReadings const& cells);
+    };
+}
+
+#endif
+
@@ -0,0 +1,257 @@
+#include <dvl_teledyne/EnsembleFilter.hpp>
+#include <base/Float.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace dvl_teledyne;
+
+FilterConfiguration::FilterConfiguration()
+    : window_size(10)
+    , min_correlation(0)
+    , min_quality(0)
+    , min_intensity(0)
+    , max_intensity(255)
+{
+}
+
+EnsembleFilter::EnsembleFilter(FilterConfiguration const& conf)
+    : mCellCount(0)
+{
+    setConfiguration(conf);
+}
+
+void EnsembleFilter::setConfiguration(FilterConfiguration const& conf)
+{
+    if (conf.window_size < 1)
+        throw std::invalid_argument("EnsembleFilter: the window size must be at least one");
+
+    mConf = conf;
+    resize(mCellCount);
+}
+
+FilterConfiguration const& EnsembleFilter::getConfiguration() const
+{
+    return mConf;
+}
+
+void EnsembleFilter::reset()
+{
+    resize(mCellCount);
+}
+
+void EnsembleFilter::resize(size_t cell_count)
+{
+    size_t window = mConf.window_size;
+    mCellCount = cell_count;
+    mNextSlot = 0;
+    mEnsembleCount = 0;
+
+    mSamples.assign(cell_count * 4 * window * CHANNELS, base::unknown<float>());
+    mCount.assign(cell_count * 4 * CHANNELS, 0);
+    mSum.assign(cell_count * 4 * CHANNELS, 0);
+    mSumSq.assign(cell_count * 4 * CHANNELS, 0);
+    mSortedVelocities.assign(cell_count * 4 * window, 0);
+
+    mMean.readings.resize(cell_count);
+    mVariance.readings.resize(cell_count);
+    mMedian.readings.resize(cell_count);
+    for (size_t cell_idx = 0; cell_idx < cell_count; ++cell_idx)
+    {
+        for (int beam = 0; beam < 4; ++beam)
+            updateOutputs(cell_idx, beam);
+    }
+}
+
+bool EnsembleFilter::isAccepted(CellReading const& reading, int beam, COORDINATE_SYSTEMS coordinate_system) const
+{
+    if (base::isUnknown(reading.velocity[beam]))
+        return false;
+
+    // The gates only apply when the corresponding message is output by the
+    // device. Values of missing messages are NaN, and any comparison with
+    // NaN is false, so these rejection tests let them pass
+    if (reading.correlation[beam] < mConf.min_correlation)
+        return false;
+    if (reading.intensity[beam] < mConf.min_intensity ||
+            reading.intensity[beam] > mConf.max_intensity)
+        return false;
+
+    float quality;
+    if (coordinate_system == BEAM)
+        quality = reading.quality[beam];
+    else
+        quality = reading.quality[0] + reading.quality[3];
+    if (quality < mConf.min_quality)
+        return false;
+
+    return true;
+}
+
+void EnsembleFilter::removeSample(size_t pair_idx, int slot)
+{
+    size_t window = mConf.window_size;
+    float const* values = &mSamples[(pair_idx * window + slot) * CHANNELS];
+    for (int channel = 0; channel < CHANNELS; ++channel)
+    {
+        float value = values[channel];
+        if (base::isNaN(value))
+            continue;
+
+        size_t idx = pair_idx * CHANNELS + channel;
+        mCount[idx]--;
+        mSum[idx]   -= value;
+        mSumSq[idx] -= static_cast<double>(value) * value;
+    }
+
+    float velocity = values[0];
+    if (!base::isNaN(velocity))
+    {
+        int count = mCount[pair_idx * CHANNELS];
+        float* sorted = &mSortedVelocities[pair_idx * window];
+        float* it = std::lower_bound(sorted, sorted + count + 1, velocity);
+        std::copy(it + 1, sorted + count + 1, it);
+    }
+}
+
+void EnsembleFilter::addSample(size_t pair_idx, int slot, float const* values)
+{
+    size_t window = mConf.window_size;
+    float* stored = &mSamples[(pair_idx * window + slot) * CHANNELS];
+    for (int channel = 0; channel < CHANNELS; ++channel)
+    {
+        float value = values[channel];
+        stored[channel] = value;
+        if (base::isNaN(value))
+            continue;
+
+        size_t idx = pair_idx * CHANNELS + channel;
+        mCount[idx]++;
+        mSum[idx]   += value;
+        mSumSq[idx] += static_cast<double>(value) * value;
+    }
+
+    float velocity = values[0];
+    if (!base::isNaN(velocity))
+    {
+        int count = mCount[pair_idx * CHANNELS];
+        float* sorted = &mSortedVelocities[pair_idx * window];
+        float* it = std::upper_bound(sorted, sorted + count - 1, velocity);
+        std::copy_backward(it, sorted + count - 1, sorted + count);
+        *it = velocity;
+    }
+}
+
+void EnsembleFilter::updateOutputs(size_t cell_idx, int beam)
+{
+    size_t pair_idx = cell_idx * 4 + beam;
+    float mean[CHANNELS];
+    float variance[CHANNELS];
+    for (int channel = 0; channel < CHANNELS; ++channel)
+    {
+        size_t idx = pair_idx * CHANNELS + channel;
+        int count = mCount[idx];
+        if (count == 0)
+        {
+            mean[channel] = base::unknown<float>();
+            variance[channel] = base::unknown<float>();
+            continue;
+        }
+
+        double m = mSum[idx] / count;
+        // Clamp to zero as the running sums accumulate rounding errors
+        double v = std::max(0.0, mSumSq[idx] / count - m * m);
+        mean[channel] = m;
+        variance[channel] = v;
+    }
+
+    CellReading& mean_cell = mMean.readings[cell_idx];
+    mean_cell.velocity[beam]    = mean[0];
+    mean_cell.correlation[beam] = mean[1];
+    mean_cell.intensity[beam]   = mean[2];
+    mean_cell.quality[beam]     = mean[3];
+
+    CellReading& variance_cell = mVariance.readings[cell_idx];
+    variance_cell.velocity[beam]    = variance[0];
+    variance_cell.correlation[beam] = variance[1];
+    variance_cell.intensity[beam]   = variance[2];
+    variance_cell.quality[beam]     = variance[3];
+
+    CellReading& median_cell = mMedian.readings[cell_idx];
+    median_cell.velocity[beam]    = mean[0];
+    median_cell.correlation[beam] = mean[1];
+    median_cell.intensity[beam]   = mean[2];
+    median_cell.quality[beam]     = mean[3];
+    int count = mCount[pair_idx * CHANNELS];
+    if (count != 0)
+    {
+        float const* sorted = &mSortedVelocities[pair_idx * mConf.window_size];
+        if (count % 2)
+            median_cell.velocity[beam] = sorted[count / 2];
+        else
+            median_cell.velocity[beam] = 0.5f * (sorted[count / 2 - 1] + sorted[count / 2]);
+    }
+}
+
+void EnsembleFilter::update(CellReadings const& readings, COORDINATE_SYSTEMS coordinate_system)
+{
+    if (readings.readings.size() != mCellCount)
+        resize(readings.readings.size());
+
+    int slot = mNextSlot;
+    bool window_full = (mEnsembleCount == mConf.window_size);
+    for (size_t cell_idx = 0; cell_idx < mCellCount; ++cell_idx)
+    {
+        CellReading const& reading = readings.readings[cell_idx];
+        for (int beam = 0; beam < 4; ++beam)
+        {
+            size_t pair_idx = cell_idx * 4 + beam;
+            if (window_full)
+                removeSample(pair_idx, slot);
+
+            float values[CHANNELS];
+            if (isAccepted(reading, beam, coordinate_system))
+            {
+                values[0] = reading.velocity[beam];
+                values[1] = reading.correlation[beam];
+                values[2] = reading.intensity[beam];
+                values[3] = reading.quality[beam];
+            }
+            else
+            {
+                for (int channel = 0; channel < CHANNELS; ++channel)
+                    values[channel] = base::unknown<float>();
+            }
+            addSample(pair_idx, slot, values);
+            updateOutputs(cell_idx, beam);
+        }
+    }
+
+    mNextSlot = (slot + 1) % mConf.window_size;
+    if (!window_full)
+        mEnsembleCount++;
+
+    mMean.time     = readings.time;
+    mVariance.time = readings.time;
+    mMedian.time   = readings.time;
+}
+
+CellReadings const& EnsembleFilter::getMean() const
+{
+    return mMean;
+}
+
+CellReadings const& EnsembleFilter::getVariance() const
+{
+    return mVariance;
+}
+
+CellReadings const& EnsembleFilter::getMedian() const
+{
+    return mMedian;
+}
+
+int EnsembleFilter::getEnsembleCount() const
+{
+    return mEnsembleCount;
+}
+
@@ -0,0 +1,124 @@
+#ifndef DVL_TELEDYNE_ENSEMBLEFILTER_HPP
+#define DVL_TELEDYNE_ENSEMBLEFILTER_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+#include <vector>
+
+namespace dvl_teledyne
+{
+    /** Configuration of EnsembleFilter */
+    struct FilterConfiguration
+    {
+        /** Number of ensembles in the sliding window */
+        int window_size;
+        /** Samples whose correlation (between 0 and 1) is below this value are
+         * discarded
+         */
+        float min_correlation;
+        /** Samples whose quality (between 0 and 1) is below this value are
+         * discarded. In BEAM coordinates, the per-beam percentage of good
+         * pings is used. In other coordinate systems, the ratio of 3-beam and
+         * 4-beam solutions is used for all the components of the cell
+         */
+        float min_quality;
+        /** Samples whose intensity (in dB) is below this value are discarded */
+        float min_intensity;
+        /** Samples whose intensity (in dB) is above this value are discarded.
+         * Use it to reject false targets
+         */
+        float max_intensity;
+
+        FilterConfiguration();
+    };
+
+    /** Streaming filter over the depth cell readings
+     *
+     * It gets fed with the CellReadings structure decoded by PD0Parser after
+     * each ensemble, and maintains for each cell and beam a sliding window of
+     * the last N ensembles. Mean and variance are maintained with running
+     * sums, so that the cost per ensemble does not depend on the window size.
+     * The median is maintained on a sorted copy of the window (this is linear
+     * in the window size, which is meant to stay small).
+     *
+     * Samples that are unknown or that fail the correlation, quality or
+     * intensity gates are not taken into account. A cell/beam pair without
+     * any valid sample in the window is reported as unknown.
+     */
+    class EnsembleFilter
+    {
+    public:
+        EnsembleFilter(FilterConfiguration const& conf = FilterConfiguration());
+
+        /** Changes the filter configuration. This resets the filter */
+        void setConfiguration(FilterConfiguration const& conf);
+        FilterConfiguration const& getConfiguration() const;
+
+        /** Removes all samples from the window */
+        void reset();
+
+        /** Adds a new ensemble to the window, removing the oldest one if the
+         * window is full, and updates the filter outputs
+         *
+         * The filter is reset if the count of cells changes.
+         */
+        void update(CellReadings const& readings, COORDINATE_SYSTEMS coordinate_system);
+
+        /** Mean of velocity, correlation, intensity and quality over the
+         * accepted samples in the window
+         */
+        CellReadings const& getMean() const;
+        /** Variance of velocity, correlation, intensity and quality over the
+         * accepted samples in the window
+         */
+        CellReadings const& getVariance() const;
+        /** Median of velocity over the accepted samples in the window. The
+         * other fields are the same as in getMean()
+         */
+        CellReadings const& getMedian() const;
+
+        /** Count of ensembles currently in the window */
+        int getEnsembleCount() const;
+
+    private:
+        /** Count of channels (velocity, correlation, intensity, quality) per
+         * cell and beam
+         */
+        static const int CHANNELS = 4;
+
+        FilterConfiguration mConf;
+        size_t mCellCount;
+        /** Index in the window of the slot that will be overwritten next */
+        int mNextSlot;
+        int mEnsembleCount;
+
+        /** Samples in the window, indexed by ((cell * 4 + beam) * window +
+         * slot) * CHANNELS + channel. Samples that are not taken into account
+         * are stored as NaN
+         */
+        std::vector<float> mSamples;
+        /** Count of valid samples, running sum and running sum of squares,
+         * indexed by (cell * 4 + beam) * CHANNELS + channel
+         */
+        std::vector<int> mCount;
+        std::vector<double> mSum;
+        std::vector<double> mSumSq;
+        /** Sorted valid velocities, indexed by (cell * 4 + beam) * window.
+         * Only the first mCount[(cell * 4 + beam) * CHANNELS] elements are
+         * meaningful
+         */
+        std::vector<float> mSortedVelocities;
+
+        CellReadings mMean;
+        CellReadings mVariance;
+        CellReadings mMedian;
+
+        void resize(size_t cell_count);
+        bool isAccepted(CellReading const& reading, int beam, COORDINATE_SYSTEMS coordinate_system) const;
+        void removeSample(size_t pair_idx, int slot);
+        void addSample(size_t pair_idx, int slot, float const* values);
+        void updateOutputs(size_t cell_idx, int beam);
+    };
+}
+
+#endif
+
@@ -0,0 +1,126 @@
+#include <dvl_teledyne/EnsembleHistory.hpp>
+#include <stdexcept>
+
+using namespace dvl_teledyne;
+
+EnsembleHistory::EnsembleHistory(size_t capacity)
+    : mSamples(capacity)
+    , mFirst(0)
+    , mSize(0)
+{
+    if (capacity == 0)
+        throw std::invalid_argument("EnsembleHistory: the capacity cannot be zero");
+}
+
+void EnsembleHistory::clear()
+{
+    mFirst = 0;
+    mSize = 0;
+}
+
+bool EnsembleHistory::push(base::Time const& time, BottomTracking const& tracking, Status const& status)
+{
+    HistorySample sample;
+    sample.time = time;
+    for (int i = 0; i < 3; ++i)
+        sample.velocity[i] = tracking.velocity[i];
+    sample.orientation = status.orientation;
+    for (int beam = 0; beam < 4; ++beam)
+        sample.range[beam] = tracking.range[beam];
+    sample.depth = status.depth;
+    return push(sample);
+}
+
+bool EnsembleHistory::push(HistorySample const& sample)
+{
+    if (mSize != 0 && sample.time <= getLastTime())
+        return false;
+
+    if (mSize == mSamples.size())
+    {
+        mSamples[mFirst] = sample;
+        mFirst = (mFirst + 1) % mSamples.size();
+    }
+    else
+    {
+        mSamples[(mFirst + mSize) % mSamples.size()] = sample;
+        mSize++;
+    }
+    return true;
+}
+
+size_t EnsembleHistory::size() const
+{
+    return mSize;
+}
+
+size_t EnsembleHistory::capacity() const
+{
+    return mSamples.size();
+}
+
+base::Time EnsembleHistory::getFirstTime() const
+{
+    return at(0).time;
+}
+
+base::Time EnsembleHistory::getLastTime() const
+{
+    return at(mSize - 1).time;
+}
+
+HistorySample const& EnsembleHistory::at(size_t i) const
+{
+    return mSamples[(mFirst + i) % mSamples.size()];
+}
+
+size_t EnsembleHistory::upperBound(base::Time const& time) const
+{
+    size_t low = 0, high = mSize;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (time < at(middle).time)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return low;
+}
+
+bool EnsembleHistory::getLatestBefore(base::Time const& time, HistorySample& sample) const
+{
+    size_t idx = upperBound(time);
+    if (idx == 0)
+        return false;
+    sample = at(idx - 1);
+    return true;
+}
+
+bool EnsembleHistory::interpolate(base::Time const& time, HistorySample& sample) const
+{
+    size_t idx = upperBound(time);
+    if (idx == 0)
+        return false;
+    if (idx == mSize)
+    {
+        // Only valid if time is exactly the last sample
+        if (at(mSize - 1).time != time)
+            return false;
+        sample = at(mSize - 1);
+        return true;
+    }
+
+    HistorySample const& before = at(idx - 1);
+    HistorySample const& after  = at(idx);
+    double t = (time - before.time).toSeconds() / (after.time - before.time).toSeconds();
+
+    sample.time        = time;
+    sample.velocity    = before.velocity + t * (after.velocity - before.velocity);
+    sample.orientation = before.orientation.slerp(t, after.orientation);
+    for (int beam = 0; beam < 4; ++beam)
+        sample.range[beam] = before.range[beam] + t * (after.range[beam] - before.range[beam]);
+    sample.depth = before.depth + t * (after.depth - before.depth);
+    return true;
+}
+
@@ -0,0 +1,91 @@
+#ifndef DVL_TELEDYNE_ENSEMBLEHISTORY_HPP
+#define DVL_TELEDYNE_ENSEMBLEHISTORY_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+#include <vector>
+
+namespace dvl_teledyne
+{
+    /** One sample of the bottom tracking and status history */
+    struct HistorySample
+    {
+        /** Timestamp under which the sample got stored */
+        base::Time time;
+        /** The first three bottom tracking velocity components. Unknown
+         * components are NaN
+         */
+        base::Vector3d velocity;
+        /** Orientation reported in the status */
+        base::Quaterniond orientation;
+        /** Ranges to the bottom, in meters */
+        float range[4];
+        /** Depth of the transducer, in meters */
+        float depth;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /** Bounded, time-indexed history of bottom tracking and status samples
+     *
+     * It is meant to provide the DVL data at arbitrary times (e.g. the
+     * timestamps of a higher-rate IMU) to sensor fusion algorithms. The
+     * memory is allocated once at construction. When the history is full,
+     * the oldest sample is overwritten. Lookups are binary searches.
+     *
+     * Samples must be pushed in increasing time order.
+     */
+    class EnsembleHistory
+    {
+    public:
+        EnsembleHistory(size_t capacity = 256);
+
+        /** Removes all samples */
+        void clear();
+
+        /** Adds a sample at the given time. \c time is usually the corrected
+         * (e.g. latency-compensated) timestamp of the ensemble
+         *
+         * Returns false, and ignores the sample, if \c time is not after the
+         * time of the last sample
+         */
+        bool push(base::Time const& time, BottomTracking const& tracking, Status const& status);
+        bool push(HistorySample const& sample);
+
+        /** Count of samples in the history */
+        size_t size() const;
+        /** Maximum count of samples in the history */
+        size_t capacity() const;
+        /** Time of the oldest and newest samples. The history must not be
+         * empty */
+        base::Time getFirstTime() const;
+        base::Time getLastTime() const;
+
+        /** Gets the latest sample whose time is before or equal to \c time
+         *
+         * Returns false if there is none
+         */
+        bool getLatestBefore(base::Time const& time, HistorySample& sample) const;
+
+        /** Interpolates the history at \c time
+         *
+         * Velocity, ranges and depth are linearly interpolated, and the
+         * orientation with a slerp, between the two samples around \c time.
+         * Returns false if \c time is outside of the history.
+         */
+        bool interpolate(base::Time const& time, HistorySample& sample) const;
+
+    private:
+        typedef std::vector< HistorySample, Eigen::aligned_allocator<HistorySample> > Samples;
+        Samples mSamples;
+        /** Index of the oldest sample */
+        size_t mFirst;
+        size_t mSize;
+
+        HistorySample const& at(size_t i) const;
+        /** Index of the first sample whose time is strictly after \c time */
+        size_t upperBound(base::Time const& time) const;
+    };
+}
+
+#endif
+
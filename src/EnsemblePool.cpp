@@ -0,0 +1,133 @@
+#include <dvl_teledyne/EnsemblePool.hpp>
+#include <dvl_teledyne/PD0Parser.hpp>
+#include <stdexcept>
+
+using namespace dvl_teledyne;
+
+EnsembleHandle::EnsembleHandle()
+    : mSlot(0)
+{
+}
+
+EnsembleHandle::EnsembleHandle(details::PooledEnsemble* slot)
+    : mSlot(slot)
+{
+}
+
+EnsembleHandle::EnsembleHandle(EnsembleHandle const& other)
+    : mSlot(other.mSlot)
+{
+    if (mSlot)
+        mSlot->refcount.fetch_add(1, std::memory_order_relaxed);
+}
+
+EnsembleHandle::~EnsembleHandle()
+{
+    release();
+}
+
+EnsembleHandle& EnsembleHandle::operator =(EnsembleHandle const& other)
+{
+    if (other.mSlot)
+        other.mSlot->refcount.fetch_add(1, std::memory_order_relaxed);
+    release();
+    mSlot = other.mSlot;
+    return *this;
+}
+
+void EnsembleHandle::release()
+{
+    // The release ordering makes sure that all accesses to the ensemble
+    // through this handle are done before the pool can reuse it
+    if (mSlot)
+        mSlot->refcount.fetch_sub(1, std::memory_order_release);
+    mSlot = 0;
+}
+
+bool EnsembleHandle::isNull() const
+{
+    return !mSlot;
+}
+
+Ensemble& EnsembleHandle::operator *() const
+{
+    return mSlot->ensemble;
+}
+
+Ensemble* EnsembleHandle::operator ->() const
+{
+    return &mSlot->ensemble;
+}
+
+Ensemble* EnsembleHandle::get() const
+{
+    return mSlot ? &mSlot->ensemble : 0;
+}
+
+EnsemblePool::EnsemblePool(size_t size, size_t cell_count)
+    : mSize(size)
+    , mSlots(new details::PooledEnsemble[size])
+    , mNext(0)
+{
+    if (size == 0)
+        throw std::invalid_argument("EnsemblePool: the pool cannot be empty");
+
+    for (size_t i = 0; i < size; ++i)
+        mSlots[i].ensemble.cellReadings.readings.resize(cell_count);
+}
+
+EnsembleHandle EnsemblePool::acquire()
+{
+    for (size_t i = 0; i < mSize; ++i)
+    {
+        details::PooledEnsemble& slot = mSlots[(mNext + i) % mSize];
+        int expected = 0;
+        if (slot.refcount.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+        {
+            mNext = (mNext + i + 1) % mSize;
+            return EnsembleHandle(&slot);
+        }
+    }
+    return EnsembleHandle();
+}
+
+EnsembleHandle EnsemblePool::fill(PD0Parser& parser)
+{
+    EnsembleHandle handle = acquire();
+    if (handle.isNull())
+        return handle;
+
+    Ensemble& ensemble = *handle;
+    ensemble.configuration_version = parser.getConfigurationVersion();
+    ensemble.deviceInfo         = parser.deviceInfo;
+    ensemble.acqConf            = parser.acqConf;
+    ensemble.outputConf         = parser.outputConf;
+    ensemble.status             = parser.status;
+    ensemble.bottomTrackingConf = parser.bottomTrackingConf;
+    ensemble.bottomTracking     = parser.bottomTracking;
+    ensemble.cellReadings.time  = parser.cellReadings.time;
+
+    // Make sure that the vector we give back to the parser has the size it
+    // expects, so that it does not have to reallocate it
+    std::vector<CellReading>& readings = ensemble.cellReadings.readings;
+    readings.resize(parser.cellReadings.readings.size());
+    readings.swap(parser.cellReadings.readings);
+    return handle;
+}
+
+size_t EnsemblePool::getSize() const
+{
+    return mSize;
+}
+
+size_t EnsemblePool::getFreeCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < mSize; ++i)
+    {
+        if (mSlots[i].refcount.load(std::memory_order_relaxed) == 0)
+            ++count;
+    }
+    return count;
+}
+
@@ -0,0 +1,106 @@
+#ifndef DVL_TELEDYNE_ENSEMBLEPOOL_HPP
+#define DVL_TELEDYNE_ENSEMBLEPOOL_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+#include <atomic>
+#include <memory>
+
+namespace dvl_teledyne
+{
+    class PD0Parser;
+    class EnsemblePool;
+
+    namespace details
+    {
+        struct PooledEnsemble
+        {
+            std::atomic<int> refcount;
+            Ensemble ensemble;
+
+            PooledEnsemble() : refcount(0) {}
+        };
+    }
+
+    /** Reference-counted handle on an ensemble of an EnsemblePool
+     *
+     * Copying a handle only increments a reference counter. The ensemble
+     * returns to the pool when the last handle gets destroyed or released.
+     * Handles can be copied to and released from any thread.
+     *
+     * The ensemble is shared between all the handles, so it must not be
+     * modified once handed out to more than one consumer.
+     */
+    class EnsembleHandle
+    {
+    public:
+        EnsembleHandle();
+        EnsembleHandle(EnsembleHandle const& other);
+        ~EnsembleHandle();
+        EnsembleHandle& operator =(EnsembleHandle const& other);
+
+        /** Releases this reference. The handle is null afterwards */
+        void release();
+
+        /** True if the handle does not point to an ensemble */
+        bool isNull() const;
+
+        Ensemble& operator *() const;
+        Ensemble* operator ->() const;
+        Ensemble* get() const;
+
+    private:
+        friend class EnsemblePool;
+        explicit EnsembleHandle(details::PooledEnsemble* slot);
+
+        details::PooledEnsemble* mSlot;
+    };
+
+    /** Pool of preallocated ensembles, to hand decoded ensembles to several
+     * consumers without copying them
+     *
+     * The pool must outlive all the handles it gave out.
+     */
+    class EnsemblePool
+    {
+    public:
+        /** Creates a pool of \c size ensembles, whose cell readings are
+         * preallocated for \c cell_count cells
+         */
+        EnsemblePool(size_t size, size_t cell_count = 0);
+
+        /** Gets a free ensemble from the pool
+         *
+         * Returns a null handle if all the ensembles are in use. This is
+         * lock-free, but only one thread may acquire ensembles from a given
+         * pool.
+         */
+        EnsembleHandle acquire();
+
+        /** Moves the ensemble that has just been decoded by \c parser into a
+         * free ensemble of the pool
+         *
+         * The cell readings are swapped between the parser and the pool's
+         * ensemble instead of being copied. The parser's cellReadings field
+         * is therefore not valid anymore after this call (it gets
+         * reinitialized by the next call to parseEnsemble). No memory is
+         * allocated unless the count of cells changed.
+         *
+         * Returns a null handle if all the ensembles are in use.
+         */
+        EnsembleHandle fill(PD0Parser& parser);
+
+        /** Count of ensembles in the pool */
+        size_t getSize() const;
+        /** Count of ensembles that are not referenced by any handle */
+        size_t getFreeCount() const;
+
+    private:
+        size_t mSize;
+        std::unique_ptr<details::PooledEnsemble[]> mSlots;
+        /** Index from which the next free slot is searched */
+        size_t mNext;
+    };
+}
+
+#endif
+
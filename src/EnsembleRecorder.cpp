@@ -0,0 +1,355 @@
+#include <dvl_teledyne/EnsembleRecorder.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace dvl_teledyne;
+
+namespace
+{
+    /** Size of the record header in the write-behind buffer: reception time
+     * in microseconds and ensemble size
+     */
+    static const size_t RECORD_HEADER_SIZE = 12;
+    /** Size of one entry in the index files */
+    static const size_t INDEX_ENTRY_SIZE = 24;
+    /** Data is written to disk in blocks of at most this size */
+    static const size_t STAGING_SIZE = 1024 * 1024;
+
+    void encodeLE(uint8_t* buffer, uint64_t value, int size)
+    {
+        for (int i = 0; i < size; ++i)
+            buffer[i] = value >> (8 * i);
+    }
+
+    bool writeAll(int fd, uint8_t const* data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t ret = ::write(fd, data, size);
+            if (ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += ret;
+            size -= ret;
+        }
+        return true;
+    }
+}
+
+RecorderConfiguration::RecorderConfiguration()
+    : buffer_size(16 * 1024 * 1024)
+    , max_file_size(256 * 1024 * 1024)
+    , max_file_duration(base::Time::fromSeconds(3600))
+    , sync_period(base::Time::fromSeconds(1))
+{
+}
+
+EnsembleRecorder::EnsembleRecorder(RecorderConfiguration const& conf)
+    : mConf(conf)
+    , mRunning(false)
+    , mBuffer(conf.buffer_size)
+    , mWritten(0)
+    , mRead(0)
+    , mDataFd(-1)
+    , mIndexFd(-1)
+    , mFileCounter(0)
+    , mFileSize(0)
+    , mEnsemblesWritten(0)
+    , mBytesWritten(0)
+    , mEnsemblesDropped(0)
+    , mFiles(0)
+    , mBufferHighWatermark(0)
+    , mWriteErrors(0)
+{
+    if (conf.buffer_size < RECORD_HEADER_SIZE)
+        throw std::invalid_argument("EnsembleRecorder: buffer too small");
+    mStaging.reserve(STAGING_SIZE);
+}
+
+EnsembleRecorder::~EnsembleRecorder()
+{
+    stop();
+}
+
+void EnsembleRecorder::start()
+{
+    if (mRunning)
+        throw std::logic_error("recorder already running");
+
+    mWritten = 0;
+    mRead = 0;
+    openFiles();
+    mRunning = true;
+    mWriterThread = std::thread(&EnsembleRecorder::writerLoop, this);
+}
+
+void EnsembleRecorder::stop()
+{
+    if (!mRunning)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mBufferMutex);
+        mRunning = false;
+    }
+    mDataAvailable.notify_all();
+    mWriterThread.join();
+}
+
+bool EnsembleRecorder::isRunning() const
+{
+    return mRunning;
+}
+
+bool EnsembleRecorder::write(uint8_t const* data, size_t size, base::Time const& time)
+{
+    size_t record_size = RECORD_HEADER_SIZE + size;
+    uint8_t header[RECORD_HEADER_SIZE];
+    encodeLE(header, time.toMicroseconds(), 8);
+    encodeLE(header + 8, size, 4);
+
+    {
+        std::lock_guard<std::mutex> lock(mBufferMutex);
+        size_t capacity = mBuffer.size();
+        if (!mRunning || capacity - (mWritten - mRead) < record_size)
+        {
+            mEnsemblesDropped++;
+            return false;
+        }
+
+        uint8_t const* parts[2] = { header, data };
+        size_t part_sizes[2] = { RECORD_HEADER_SIZE, size };
+        for (int i = 0; i < 2; ++i)
+        {
+            size_t pos   = mWritten % capacity;
+            size_t first = std::min(part_sizes[i], capacity - pos);
+            memcpy(&mBuffer[pos], parts[i], first);
+            memcpy(&mBuffer[0], parts[i] + first, part_sizes[i] - first);
+            mWritten += part_sizes[i];
+        }
+
+        uint64_t occupancy = mWritten - mRead;
+        if (occupancy > mBufferHighWatermark)
+            mBufferHighWatermark = occupancy;
+    }
+    mDataAvailable.notify_one();
+    return true;
+}
+
+void EnsembleRecorder::copyFromBuffer(uint64_t position, uint8_t* data, size_t size) const
+{
+    size_t capacity = mBuffer.size();
+    size_t pos   = position % capacity;
+    size_t first = std::min(size, capacity - pos);
+    memcpy(data, &mBuffer[pos], first);
+    memcpy(data + first, &mBuffer[0], size - first);
+}
+
+RecorderStatistics EnsembleRecorder::getStatistics() const
+{
+    RecorderStatistics stats;
+    stats.ensembles_written = mEnsemblesWritten;
+    stats.bytes_written     = mBytesWritten;
+    stats.ensembles_dropped = mEnsemblesDropped;
+    stats.files             = mFiles;
+    stats.buffer_high_watermark = mBufferHighWatermark;
+    stats.write_errors      = mWriteErrors;
+    {
+        std::lock_guard<std::mutex> lock(mBufferMutex);
+        stats.buffer_occupancy = mWritten - mRead;
+    }
+    return stats;
+}
+
+std::string EnsembleRecorder::getCurrentFileName() const
+{
+    std::lock_guard<std::mutex> lock(mFileNameMutex);
+    return mCurrentFileName;
+}
+
+void EnsembleRecorder::openFiles()
+{
+    char counter[32];
+    snprintf(counter, sizeof(counter), ".%06llu", static_cast<unsigned long long>(mFileCounter++));
+    std::string basename = mConf.prefix + counter;
+
+    std::string data_path = basename + ".pd0";
+    mDataFd = ::open(data_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (mDataFd < 0)
+        throw std::runtime_error("cannot create " + data_path + ": " + strerror(errno));
+
+    std::string index_path = basename + ".idx";
+    mIndexFd = ::open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (mIndexFd < 0)
+    {
+        int error = errno;
+        ::close(mDataFd);
+        mDataFd = -1;
+        throw std::runtime_error("cannot create " + index_path + ": " + strerror(error));
+    }
+
+    mFileSize  = 0;
+    mFileStart = base::Time::now();
+    mLastSync  = mFileStart;
+    mFiles++;
+
+    std::lock_guard<std::mutex> lock(mFileNameMutex);
+    mCurrentFileName = data_path;
+}
+
+void EnsembleRecorder::closeFiles()
+{
+    // Entries that are not synced yet are lost, as we cannot guarantee that
+    // the data they point to made it to disk
+    mUnsyncedIndex.clear();
+    if (mDataFd >= 0)
+        ::close(mDataFd);
+    if (mIndexFd >= 0)
+        ::close(mIndexFd);
+    mDataFd = -1;
+    mIndexFd = -1;
+}
+
+void EnsembleRecorder::flushStaging()
+{
+    if (mStaging.empty())
+        return;
+
+    if (mDataFd >= 0 && writeAll(mDataFd, &mStaging[0], mStaging.size()))
+    {
+        mEnsemblesWritten += mStagedIndex.size();
+        mBytesWritten += mStaging.size();
+        mUnsyncedIndex.insert(mUnsyncedIndex.end(), mStagedIndex.begin(), mStagedIndex.end());
+    }
+    else
+    {
+        // The file is now in an unknown state. Drop what we have and start
+        // a new file at the next batch
+        mWriteErrors++;
+        mEnsemblesDropped += mStagedIndex.size();
+        closeFiles();
+    }
+    mStaging.clear();
+    mStagedIndex.clear();
+}
+
+void EnsembleRecorder::sync()
+{
+    mLastSync = base::Time::now();
+    if (mDataFd < 0 || mUnsyncedIndex.empty())
+        return;
+
+    // Sync the data before writing the index entries that point to it, so
+    // that the index never references data that is not on disk
+    if (fdatasync(mDataFd))
+    {
+        mWriteErrors++;
+        return;
+    }
+
+    std::vector<uint8_t> entries(mUnsyncedIndex.size() * INDEX_ENTRY_SIZE, 0);
+    for (size_t i = 0; i < mUnsyncedIndex.size(); ++i)
+    {
+        uint8_t* entry = &entries[i * INDEX_ENTRY_SIZE];
+        encodeLE(entry, mUnsyncedIndex[i].time, 8);
+        encodeLE(entry + 8, mUnsyncedIndex[i].offset, 8);
+        encodeLE(entry + 16, mUnsyncedIndex[i].size, 4);
+    }
+    mUnsyncedIndex.clear();
+    if (!writeAll(mIndexFd, &entries[0], entries.size()) || fdatasync(mIndexFd))
+        mWriteErrors++;
+}
+
+void EnsembleRecorder::writerLoop()
+{
+    std::chrono::microseconds wait_time(mConf.sync_period.toMicroseconds());
+    std::vector<uint8_t> header(RECORD_HEADER_SIZE);
+    while (true)
+    {
+        uint64_t read, written;
+        bool running;
+        {
+            std::unique_lock<std::mutex> lock(mBufferMutex);
+            mDataAvailable.wait_for(lock, wait_time,
+                    [this] { return !mRunning || mWritten != mRead; });
+            read = mRead;
+            written = mWritten;
+            running = mRunning;
+        }
+        if (!running && read == written)
+            break;
+
+        if (mDataFd < 0)
+        {
+            try { openFiles(); }
+            catch(std::runtime_error const&) { mWriteErrors++; }
+        }
+
+        // The region [read, written) is not touched by write() until we
+        // advance mRead, so we can access it without holding the lock
+        while (read < written)
+        {
+            copyFromBuffer(read, &header[0], RECORD_HEADER_SIZE);
+            int64_t time = 0;
+            uint32_t size = 0;
+            for (int i = 0; i < 8; ++i)
+                time |= static_cast<int64_t>(header[i]) << (8 * i);
+            for (int i = 0; i < 4; ++i)
+                size |= static_cast<uint32_t>(header[8 + i]) << (8 * i);
+
+            if (mDataFd < 0)
+                mEnsemblesDropped++;
+            else
+            {
+                bool too_big = mFileSize > 0 && mFileSize + size > mConf.max_file_size;
+                bool too_old = mFileSize > 0 && !mConf.max_file_duration.isNull() &&
+                    base::Time::now() - mFileStart > mConf.max_file_duration;
+                if (too_big || too_old)
+                {
+                    flushStaging();
+                    sync();
+                    closeFiles();
+                    try { openFiles(); }
+                    catch(std::runtime_error const&) { mWriteErrors++; }
+                }
+
+                if (mStaging.size() + size > STAGING_SIZE)
+                    flushStaging();
+
+                if (mDataFd < 0)
+                    mEnsemblesDropped++;
+                else
+                {
+                    IndexEntry entry = { time, mFileSize, size };
+                    mStagedIndex.push_back(entry);
+                    size_t offset = mStaging.size();
+                    mStaging.resize(offset + size);
+                    copyFromBuffer(read + RECORD_HEADER_SIZE, &mStaging[offset], size);
+                    mFileSize += size;
+                }
+            }
+            read += RECORD_HEADER_SIZE + size;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mBufferMutex);
+            mRead = read;
+        }
+
+        flushStaging();
+        if (!running || base::Time::now() - mLastSync >= mConf.sync_period)
+            sync();
+    }
+
+    flushStaging();
+    sync();
+    closeFiles();
+}
@@ -0,0 +1,160 @@
+#ifndef DVL_TELEDYNE_ENSEMBLERECORDER_HPP
+#define DVL_TELEDYNE_ENSEMBLERECORDER_HPP
+
+#include <base/Time.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dvl_teledyne
+{
+    struct RecorderConfiguration
+    {
+        /** Path prefix of the recording files. A file counter and the
+         * .pd0 / .idx extensions get appended to it
+         */
+        std::string prefix;
+        /** Size of the write-behind buffer, in bytes. Ensembles that do not
+         * fit in it are dropped
+         */
+        size_t buffer_size;
+        /** A new file is started when the current one would exceed this
+         * size, in bytes
+         */
+        uint64_t max_file_size;
+        /** A new file is started when the current one is older than this.
+         * Null to rotate by size only
+         */
+        base::Time max_file_duration;
+        /** Period at which the files are flushed to the storage with
+         * fdatasync()
+         */
+        base::Time sync_period;
+
+        RecorderConfiguration();
+    };
+
+    struct RecorderStatistics
+    {
+        /** Count of ensembles and bytes written to disk */
+        uint64_t ensembles_written;
+        uint64_t bytes_written;
+        /** Count of ensembles dropped because the buffer was full, or
+         * because of a write error
+         */
+        uint64_t ensembles_dropped;
+        /** Count of files created so far */
+        uint64_t files;
+        /** Current and maximum occupancy of the write-behind buffer, in
+         * bytes
+         */
+        uint64_t buffer_occupancy;
+        uint64_t buffer_high_watermark;
+        /** Count of failed writes or syncs */
+        uint64_t write_errors;
+    };
+
+    /** Records raw PD0 ensembles to disk without ever blocking the caller
+     *
+     * write() copies the ensemble into a preallocated buffer, and a writer
+     * thread flushes that buffer to disk. When the storage cannot keep up,
+     * new ensembles are dropped (and counted) instead of making the reader
+     * wait.
+     *
+     * Each file <prefix>.<N>.pd0 is the plain concatenation of the
+     * ensembles, as received from the device. It is accompanied by an
+     * index <prefix>.<N>.idx made of one 24-byte little-endian entry per
+     * ensemble: reception time in microseconds since the epoch (int64),
+     * offset in the .pd0 file (uint64), size (uint32) and four reserved
+     * bytes. Index entries are written only after the data they point to has
+     * been synced, so that the index is always consistent with the data
+     * after a crash.
+     */
+    class EnsembleRecorder
+    {
+    public:
+        EnsembleRecorder(RecorderConfiguration const& conf);
+        ~EnsembleRecorder();
+
+        /** Creates the first file and starts the writer thread
+         *
+         * Throws std::runtime_error if the file cannot be created
+         */
+        void start();
+        /** Writes everything that is buffered, syncs and closes the files */
+        void stop();
+        bool isRunning() const;
+
+        /** Queues an ensemble received at \c time for writing
+         *
+         * It is meant to be called by a single thread, the one that reads
+         * the device. Returns false if the ensemble got dropped because the
+         * buffer is full
+         */
+        bool write(uint8_t const* data, size_t size, base::Time const& time);
+
+        RecorderStatistics getStatistics() const;
+
+        /** Name of the file currently being written */
+        std::string getCurrentFileName() const;
+
+    private:
+        struct IndexEntry
+        {
+            int64_t time;
+            uint64_t offset;
+            uint32_t size;
+        };
+
+        RecorderConfiguration mConf;
+        std::atomic<bool> mRunning;
+        std::thread mWriterThread;
+
+        /** The write-behind buffer, as a ring of records made of a 12-byte
+         * header (time and size) followed by the ensemble
+         */
+        std::vector<uint8_t> mBuffer;
+        /** Monotonic write and read counters. The positions in mBuffer are
+         * the counters modulo its size
+         */
+        uint64_t mWritten;
+        uint64_t mRead;
+        mutable std::mutex mBufferMutex;
+        std::condition_variable mDataAvailable;
+
+        // The following fields are only accessed by the writer thread, or
+        // while it is not running
+        int mDataFd;
+        int mIndexFd;
+        uint64_t mFileCounter;
+        uint64_t mFileSize;
+        base::Time mFileStart;
+        base::Time mLastSync;
+        std::vector<uint8_t> mStaging;
+        std::vector<IndexEntry> mStagedIndex;
+        std::vector<IndexEntry> mUnsyncedIndex;
+
+        mutable std::mutex mFileNameMutex;
+        std::string mCurrentFileName;
+
+        std::atomic<uint64_t> mEnsemblesWritten;
+        std::atomic<uint64_t> mBytesWritten;
+        std::atomic<uint64_t> mEnsemblesDropped;
+        std::atomic<uint64_t> mFiles;
+        std::atomic<uint64_t> mBufferHighWatermark;
+        std::atomic<uint64_t> mWriteErrors;
+
+        void writerLoop();
+        void copyFromBuffer(uint64_t position, uint8_t* data, size_t size) const;
+        void openFiles();
+        void closeFiles();
+        void flushStaging();
+        void sync();
+    };
+}
+
+#endif
+
@@ -0,0 +1,224 @@
+#include <dvl_teledyne/LinkStatistics.hpp>
+
+using namespace dvl_teledyne;
+
+LinkStatistics::LinkStatistics()
+    : mRatePeriod(base::Time::fromSeconds(1.).toMicroseconds())
+{
+    reset();
+}
+
+LinkStatistics::LinkStatistics(LinkStatistics const& other)
+{
+    *this = other;
+}
+
+LinkStatistics& LinkStatistics::operator =(LinkStatistics const& other)
+{
+    mBytesReceived      = other.mBytesReceived.load();
+    mValidEnsembles     = other.mValidEnsembles.load();
+    mDiscardedBytes     = other.mDiscardedBytes.load();
+    mChecksumFailures   = other.mChecksumFailures.load();
+    mHeaderRejects      = other.mHeaderRejects.load();
+    mResyncs            = other.mResyncs.load();
+    mSequenceGaps       = other.mSequenceGaps.load();
+    mLostEnsembles      = other.mLostEnsembles.load();
+    mDecodeErrors       = other.mDecodeErrors.load();
+    mReconfigurations   = other.mReconfigurations.load();
+    mLastReconfigurationGap = other.mLastReconfigurationGap.load();
+    mMaxReconfigurationGap  = other.mMaxReconfigurationGap.load();
+    mStalls             = other.mStalls.load();
+    mDeviceRestarts     = other.mDeviceRestarts.load();
+    mRecoveries         = other.mRecoveries.load();
+    mFailedRecoveries   = other.mFailedRecoveries.load();
+    mLastTimeToRecover  = other.mLastTimeToRecover.load();
+    mMaxTimeToRecover   = other.mMaxTimeToRecover.load();
+    mTotalTimeToRecover = other.mTotalTimeToRecover.load();
+    mEnsemblesPerSecond = other.mEnsemblesPerSecond.load();
+    mBytesPerSecond     = other.mBytesPerSecond.load();
+    mRateUpdateTime     = other.mRateUpdateTime.load();
+    mRatePeriod         = other.mRatePeriod.load();
+    mDiscarding         = other.mDiscarding;
+    mHasSeq             = other.mHasSeq;
+    mLastSeq            = other.mLastSeq;
+    mRateStart          = other.mRateStart;
+    mRateStartEnsembles = other.mRateStartEnsembles;
+    mRateStartBytes     = other.mRateStartBytes;
+    return *this;
+}
+
+void LinkStatistics::setRatePeriod(base::Time const& period)
+{
+    mRatePeriod = period.toMicroseconds();
+}
+
+void LinkStatistics::reset()
+{
+    mBytesReceived      = 0;
+    mValidEnsembles     = 0;
+    mDiscardedBytes     = 0;
+    mChecksumFailures   = 0;
+    mHeaderRejects      = 0;
+    mResyncs            = 0;
+    mSequenceGaps       = 0;
+    mLostEnsembles      = 0;
+    mDecodeErrors       = 0;
+    mReconfigurations   = 0;
+    mLastReconfigurationGap = 0;
+    mMaxReconfigurationGap  = 0;
+    mStalls             = 0;
+    mDeviceRestarts     = 0;
+    mRecoveries         = 0;
+    mFailedRecoveries   = 0;
+    mLastTimeToRecover  = 0;
+    mMaxTimeToRecover   = 0;
+    mTotalTimeToRecover = 0;
+    mEnsemblesPerSecond = 0;
+    mBytesPerSecond     = 0;
+    mDiscarding         = false;
+    mHasSeq             = false;
+    mLastSeq            = 0;
+    mRateStart          = base::Time::now();
+    mRateUpdateTime     = mRateStart.toMicroseconds();
+    mRateStartEnsembles = 0;
+    mRateStartBytes     = 0;
+}
+
+void LinkStatistics::discardedBytes(size_t count)
+{
+    mDiscarding = true;
+    mDiscardedBytes.fetch_add(count, std::memory_order_relaxed);
+    mBytesReceived.fetch_add(count, std::memory_order_relaxed);
+}
+
+void LinkStatistics::checksumFailure()
+{
+    mChecksumFailures.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkStatistics::headerReject()
+{
+    mHeaderRejects.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkStatistics::validEnsemble(size_t size)
+{
+    if (mDiscarding)
+    {
+        mResyncs.fetch_add(1, std::memory_order_relaxed);
+        mDiscarding = false;
+    }
+    mValidEnsembles.fetch_add(1, std::memory_order_relaxed);
+    mBytesReceived.fetch_add(size, std::memory_order_relaxed);
+    updateRates();
+}
+
+void LinkStatistics::sequenceNumber(uint32_t seq)
+{
+    if (mHasSeq && seq != mLastSeq + 1)
+    {
+        mSequenceGaps.fetch_add(1, std::memory_order_relaxed);
+        // A sequence number that goes backwards means that the device got
+        // restarted. We can't know how many ensembles got lost then
+        if (seq > mLastSeq)
+            mLostEnsembles.fetch_add(seq - mLastSeq - 1, std::memory_order_relaxed);
+    }
+    mHasSeq  = true;
+    mLastSeq = seq;
+}
+
+void LinkStatistics::decodeError()
+{
+    mDecodeErrors.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkStatistics::reconfiguration(base::Time const& gap)
+{
+    int64_t gap_us = gap.toMicroseconds();
+    mReconfigurations.fetch_add(1, std::memory_order_relaxed);
+    mLastReconfigurationGap.store(gap_us, std::memory_order_relaxed);
+    if (gap_us > mMaxReconfigurationGap.load(std::memory_order_relaxed))
+        mMaxReconfigurationGap.store(gap_us, std::memory_order_relaxed);
+}
+
+void LinkStatistics::stall()
+{
+    mStalls.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkStatistics::deviceRestart()
+{
+    mDeviceRestarts.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkStatistics::recoveryFailure()
+{
+    mFailedRecoveries.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkStatistics::recovery(base::Time const& time_to_recover)
+{
+    int64_t time_us = time_to_recover.toMicroseconds();
+    mTotalTimeToRecover.fetch_add(time_us, std::memory_order_relaxed);
+    mLastTimeToRecover.store(time_us, std::memory_order_relaxed);
+    if (time_us > mMaxTimeToRecover.load(std::memory_order_relaxed))
+        mMaxTimeToRecover.store(time_us, std::memory_order_relaxed);
+    mRecoveries.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkStatistics::updateRates()
+{
+    base::Time now = base::Time::now();
+    base::Time elapsed = now - mRateStart;
+    if (elapsed.toMicroseconds() < mRatePeriod.load(std::memory_order_relaxed))
+        return;
+
+    uint64_t ensembles = mValidEnsembles.load(std::memory_order_relaxed);
+    uint64_t bytes     = mBytesReceived.load(std::memory_order_relaxed);
+    mEnsemblesPerSecond.store((ensembles - mRateStartEnsembles) / elapsed.toSeconds(), std::memory_order_relaxed);
+    mBytesPerSecond.store((bytes - mRateStartBytes) / elapsed.toSeconds(), std::memory_order_relaxed);
+    mRateUpdateTime.store(now.toMicroseconds(), std::memory_order_relaxed);
+    mRateStart = now;
+    mRateStartEnsembles = ensembles;
+    mRateStartBytes = bytes;
+}
+
+LinkStats LinkStatistics::get() const
+{
+    LinkStats stats;
+    stats.time              = base::Time::now();
+    stats.bytes_received    = mBytesReceived.load(std::memory_order_relaxed);
+    stats.valid_ensembles   = mValidEnsembles.load(std::memory_order_relaxed);
+    stats.discarded_bytes   = mDiscardedBytes.load(std::memory_order_relaxed);
+    stats.checksum_failures = mChecksumFailures.load(std::memory_order_relaxed);
+    stats.header_rejects    = mHeaderRejects.load(std::memory_order_relaxed);
+    stats.resyncs           = mResyncs.load(std::memory_order_relaxed);
+    stats.sequence_gaps     = mSequenceGaps.load(std::memory_order_relaxed);
+    stats.lost_ensembles    = mLostEnsembles.load(std::memory_order_relaxed);
+    stats.decode_errors     = mDecodeErrors.load(std::memory_order_relaxed);
+    stats.reconfigurations  = mReconfigurations.load(std::memory_order_relaxed);
+    stats.last_reconfiguration_gap = base::Time::fromMicroseconds(mLastReconfigurationGap.load(std::memory_order_relaxed));
+    stats.max_reconfiguration_gap  = base::Time::fromMicroseconds(mMaxReconfigurationGap.load(std::memory_order_relaxed));
+    stats.stalls            = mStalls.load(std::memory_order_relaxed);
+    stats.device_restarts   = mDeviceRestarts.load(std::memory_order_relaxed);
+    stats.recoveries        = mRecoveries.load(std::memory_order_relaxed);
+    stats.failed_recoveries = mFailedRecoveries.load(std::memory_order_relaxed);
+    stats.last_time_to_recover = base::Time::fromMicroseconds(mLastTimeToRecover.load(std::memory_order_relaxed));
+    stats.max_time_to_recover  = base::Time::fromMicroseconds(mMaxTimeToRecover.load(std::memory_order_relaxed));
+    if (stats.recoveries)
+        stats.mean_time_to_recover = base::Time::fromMicroseconds(
+                mTotalTimeToRecover.load(std::memory_order_relaxed) / static_cast<int64_t>(stats.recoveries));
+
+    int64_t since_update = stats.time.toMicroseconds() - mRateUpdateTime.load(std::memory_order_relaxed);
+    if (since_update > 2 * mRatePeriod.load(std::memory_order_relaxed))
+    {
+        stats.ensembles_per_second = 0;
+        stats.bytes_per_second = 0;
+    }
+    else
+    {
+        stats.ensembles_per_second = mEnsemblesPerSecond.load(std::memory_order_relaxed);
+        stats.bytes_per_second     = mBytesPerSecond.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
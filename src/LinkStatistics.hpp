@@ -0,0 +1,169 @@
+#ifndef DVL_TELEDYNE_LINKSTATISTICS_HPP
+#define DVL_TELEDYNE_LINKSTATISTICS_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <base/Time.hpp>
+
+namespace dvl_teledyne
+{
+    /** Link health and throughput counters, as returned by
+     * PD0Parser::getLinkStats
+     */
+    struct LinkStats
+    {
+        /** Time at which the counters got sampled */
+        base::Time time;
+
+        /** Count of bytes processed by the framing, i.e. the sum of
+         * discarded_bytes and of the size of all the extracted ensembles
+         */
+        uint64_t bytes_received;
+        /** Count of ensembles that passed the framing checks */
+        uint64_t valid_ensembles;
+        /** Count of bytes dropped while looking for a valid ensemble */
+        uint64_t discarded_bytes;
+        /** Count of ensemble candidates with an invalid checksum */
+        uint64_t checksum_failures;
+        /** Count of ensemble candidates rejected because of an invalid
+         * header (wrong data source ID, size or message offsets)
+         */
+        uint64_t header_rejects;
+        /** Count of times the framing found a valid ensemble after having
+         * had to discard bytes
+         */
+        uint64_t resyncs;
+        /** Count of discontinuities in the ensemble sequence numbers */
+        uint64_t sequence_gaps;
+        /** Count of ensembles missing according to the sequence numbers */
+        uint64_t lost_ensembles;
+        /** Count of messages that failed to decode, see PARSE_STATUS */
+        uint64_t decode_errors;
+
+        /** Count of reconfigurations that interrupted the acquisition, see
+         * Driver::reconfigure
+         */
+        uint64_t reconfigurations;
+        /** Time between the last ensemble received before a reconfiguration
+         * and the first one received after it, for the last reconfiguration
+         * and the worst one so far
+         */
+        base::Time last_reconfiguration_gap;
+        base::Time max_reconfiguration_gap;
+
+        /** Count of times the data stream stalled, as detected by the
+         * supervised mode of Driver
+         */
+        uint64_t stalls;
+        /** Count of watchdog restarts and power failures reported by the
+         * device, as detected by the supervised mode of Driver
+         */
+        uint64_t device_restarts;
+        /** Count of recoveries that brought the data stream back */
+        uint64_t recoveries;
+        /** Count of recovery attempts during which the device did not
+         * answer
+         */
+        uint64_t failed_recoveries;
+        /** Time between the last ensemble received before a failure and the
+         * first one received after the recovery, for the last recovery, the
+         * worst one so far and on average
+         */
+        base::Time last_time_to_recover;
+        base::Time max_time_to_recover;
+        base::Time mean_time_to_recover;
+
+        /** Rolling rate of valid ensembles, in ensembles per second */
+        float ensembles_per_second;
+        /** Rolling rate of bytes received, in bytes per second */
+        float bytes_per_second;
+    };
+
+    /** Lock-free implementation of the link counters
+     *
+     * The counters are updated by the thread that does the framing and
+     * decoding, and can be read from any other thread with get(). The
+     * rolling rates are recomputed at most once per rate period.
+     */
+    class LinkStatistics
+    {
+    public:
+        LinkStatistics();
+        LinkStatistics(LinkStatistics const& other);
+        LinkStatistics& operator =(LinkStatistics const& other);
+
+        /** Sets the period over which the rates are computed */
+        void setRatePeriod(base::Time const& period);
+
+        /** Resets all counters to zero */
+        void reset();
+
+        void discardedBytes(size_t count);
+        void checksumFailure();
+        void headerReject();
+        /** Registers a valid ensemble of \c size bytes returned by the framing
+         */
+        void validEnsemble(size_t size);
+        /** Registers the sequence number of a decoded ensemble */
+        void sequenceNumber(uint32_t seq);
+        /** Registers a message that failed to decode */
+        void decodeError();
+        /** Registers the data gap caused by a reconfiguration of the device */
+        void reconfiguration(base::Time const& gap);
+        /** Registers a stall of the data stream */
+        void stall();
+        /** Registers a restart of the device */
+        void deviceRestart();
+        /** Registers a recovery attempt during which the device did not
+         * answer
+         */
+        void recoveryFailure();
+        /** Registers a completed recovery */
+        void recovery(base::Time const& time_to_recover);
+
+        LinkStats get() const;
+
+    private:
+        std::atomic<uint64_t> mBytesReceived;
+        std::atomic<uint64_t> mValidEnsembles;
+        std::atomic<uint64_t> mDiscardedBytes;
+        std::atomic<uint64_t> mChecksumFailures;
+        std::atomic<uint64_t> mHeaderRejects;
+        std::atomic<uint64_t> mResyncs;
+        std::atomic<uint64_t> mSequenceGaps;
+        std::atomic<uint64_t> mLostEnsembles;
+        std::atomic<uint64_t> mDecodeErrors;
+        std::atomic<uint64_t> mReconfigurations;
+        /** Reconfiguration gaps, in microseconds */
+        std::atomic<int64_t> mLastReconfigurationGap;
+        std::atomic<int64_t> mMaxReconfigurationGap;
+        std::atomic<uint64_t> mStalls;
+        std::atomic<uint64_t> mDeviceRestarts;
+        std::atomic<uint64_t> mRecoveries;
+        std::atomic<uint64_t> mFailedRecoveries;
+        /** Times to recover, in microseconds */
+        std::atomic<int64_t> mLastTimeToRecover;
+        std::atomic<int64_t> mMaxTimeToRecover;
+        std::atomic<int64_t> mTotalTimeToRecover;
+        std::atomic<float> mEnsemblesPerSecond;
+        std::atomic<float> mBytesPerSecond;
+        /** Time of the last rate update, in microseconds. The rates are
+         * reported as zero if they did not get updated for two periods
+         */
+        std::atomic<int64_t> mRateUpdateTime;
+        std::atomic<int64_t> mRatePeriod;
+
+        // The following fields are only accessed by the writer thread
+        bool mDiscarding;
+        bool mHasSeq;
+        uint32_t mLastSeq;
+        base::Time mRateStart;
+        uint64_t mRateStartEnsembles;
+        uint64_t mRateStartBytes;
+
+        void updateRates();
+    };
+}
+
+#endif
+
@@ -1,22 +1,40 @@
 #include <dvl_teledyne/Driver.hpp>
 #include <iostream>
+#include <string>
 
 using namespace dvl_teledyne;
 
 void usage()
 {
-    std::cerr << "dvl_teledyne_read DEVICE" << std::endl;
+    std::cerr << "dvl_teledyne_read DEVICE [PD0|PD4|PD5|PD6]" << std::endl;
 }
 
 int main(int argc, char const* argv[])
 {
-    if (argc != 2)
+    if (argc < 2 || argc > 3)
     {
         usage();
         return 1;
     }
 
     dvl_teledyne::Driver driver;
+    if (argc == 3)
+    {
+        std::string format = argv[2];
+        if (format == "PD0")
+            driver.setOutputFormat(FORMAT_PD0);
+        else if (format == "PD4")
+            driver.setOutputFormat(FORMAT_PD4);
+        else if (format == "PD5")
+            driver.setOutputFormat(FORMAT_PD5);
+        else if (format == "PD6")
+            driver.setOutputFormat(FORMAT_PD6);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
     driver.open(argv[1]);
     driver.setReadTimeout(base::Time::fromSeconds(5));
     driver.read();
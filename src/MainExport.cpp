@@ -0,0 +1,171 @@
+#include <dvl_teledyne/Driver.hpp>
+#include <dvl_teledyne/EnsembleExporter.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace dvl_teledyne;
+
+/** Maximum time exported data stays in the buffer when reading a device */
+static const base::Time LIVE_FLUSH_PERIOD = base::Time::fromMilliseconds(100);
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleSignal(int)
+{
+    interrupted = 1;
+}
+
+void usage()
+{
+    std::cerr << "dvl_teledyne_export [-f csv|jsonl|binary] [-s FIELDS] DEVICE" << std::endl;
+    std::cerr << "dvl_teledyne_export [-f csv|jsonl|binary] [-s FIELDS] -r FILE" << std::endl;
+    std::cerr << "  writes the decoded ensembles of a device, or of a PD0 recording such as" << std::endl;
+    std::cerr << "  the .pd0 files of dvl_teledyne_recorder, on standard output" << std::endl;
+    std::cerr << "  FIELDS is a comma-separated list of status, bottom, velocity," << std::endl;
+    std::cerr << "  correlation, intensity, quality and cells (all cell quantities)." << std::endl;
+    std::cerr << "  It defaults to status,bottom" << std::endl;
+}
+
+static void exportRecording(std::string const& path, EnsembleExporter& exporter)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error("cannot open " + path + ": " + strerror(errno));
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || file_stat.st_size == 0)
+    {
+        ::close(fd);
+        return;
+    }
+
+    size_t size = file_stat.st_size;
+    void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("cannot map " + path + ": " + strerror(error));
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    uint8_t const* data = static_cast<uint8_t const*>(mapped);
+    PD0Parser parser;
+    size_t offset = 0;
+    size_t ensemble_size;
+    PARSE_STATUS result;
+    try
+    {
+        while (!interrupted && parser.parseNextEnsemble(data, size, offset, ensemble_size, result))
+        {
+            if (result == PARSE_OK)
+                exporter.write(parser);
+            offset += ensemble_size;
+        }
+    }
+    catch(...)
+    {
+        munmap(mapped, size);
+        throw;
+    }
+    munmap(mapped, size);
+}
+
+static void exportDevice(std::string const& uri, EnsembleExporter& exporter)
+{
+    Driver driver;
+    driver.open(uri);
+    driver.setReadTimeout(base::Time::fromSeconds(5));
+
+    base::Time last_flush = base::Time::now();
+    while (!interrupted)
+    {
+        try { driver.read(); }
+        catch(iodrivers_base::TimeoutError const&)
+        {
+            std::cerr << "no data received in the last 5 seconds\n";
+            exporter.flush();
+            continue;
+        }
+        exporter.write(driver);
+
+        base::Time now = base::Time::now();
+        if (now - last_flush > LIVE_FLUSH_PERIOD)
+        {
+            exporter.flush();
+            last_flush = now;
+        }
+    }
+}
+
+int main(int argc, char const* argv[])
+{
+    EXPORT_FORMATS format = EXPORT_CSV;
+    std::string fields = "status,bottom";
+    bool recording = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; ++arg)
+    {
+        std::string option = argv[arg];
+        if (option == "-r")
+            recording = true;
+        else if (option == "-s" && arg + 1 < argc)
+            fields = argv[++arg];
+        else if (option == "-f" && arg + 1 < argc)
+        {
+            std::string name = argv[++arg];
+            if (name == "csv")
+                format = EXPORT_CSV;
+            else if (name == "jsonl")
+                format = EXPORT_JSONL;
+            else if (name == "binary")
+                format = EXPORT_BINARY;
+            else
+            {
+                usage();
+                return 1;
+            }
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (arg != argc - 1)
+    {
+        usage();
+        return 1;
+    }
+
+    int field_set;
+    try { field_set = EnsembleExporter::parseFields(fields); }
+    catch(std::invalid_argument const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        usage();
+        return 1;
+    }
+
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+
+    EnsembleExporter exporter(STDOUT_FILENO, format, field_set);
+    try
+    {
+        if (recording)
+            exportRecording(argv[arg], exporter);
+        else
+            exportDevice(argv[arg], exporter);
+        exporter.flush();
+    }
+    catch(std::runtime_error const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <dvl_teledyne/Driver.hpp>
+#include <dvl_teledyne/EnsembleRecorder.hpp>
+#include <iostream>
+#include <stdlib.h>
+#include <signal.h>
+
+using namespace dvl_teledyne;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleSignal(int)
+{
+    interrupted = 1;
+}
+
+void usage()
+{
+    std::cerr << "dvl_teledyne_recorder DEVICE PREFIX [MAX_FILE_SIZE_MB] [MAX_FILE_DURATION_S]" << std::endl;
+}
+
+int main(int argc, char const* argv[])
+{
+    if (argc < 3 || argc > 5)
+    {
+        usage();
+        return 1;
+    }
+
+    RecorderConfiguration conf;
+    conf.prefix = argv[2];
+    if (argc > 3)
+        conf.max_file_size = strtoull(argv[3], 0, 10) * 1024 * 1024;
+    if (argc > 4)
+        conf.max_file_duration = base::Time::fromSeconds(atof(argv[4]));
+
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+
+    dvl_teledyne::Driver driver;
+    driver.open(argv[1]);
+
+    EnsembleRecorder recorder(conf);
+    recorder.start();
+
+    // The recorder does not need the decoded data, so read the raw
+    // ensembles directly and leave the decoding to the offline tools
+    base::Time last_report = base::Time::now();
+    while (!interrupted)
+    {
+        int packet_size;
+        try { packet_size = driver.readRawPacket(base::Time::fromSeconds(1)); }
+        catch(iodrivers_base::TimeoutError const&)
+        {
+            std::cerr << "no data received in the last second\n";
+            continue;
+        }
+        base::Time now = base::Time::now();
+        recorder.write(driver.getRawPacket(), packet_size, now);
+
+        if (now - last_report > base::Time::fromSeconds(10))
+        {
+            RecorderStatistics stats = recorder.getStatistics();
+            std::cerr << recorder.getCurrentFileName() << ": "
+                << stats.ensembles_written << " ensembles written, "
+                << stats.ensembles_dropped << " dropped, "
+                << stats.write_errors << " write errors, buffer high watermark "
+                << stats.buffer_high_watermark << " bytes\n";
+            last_report = now;
+        }
+    }
+
+    recorder.stop();
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <dvl_teledyne/RecordingStatistics.hpp>
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+using namespace dvl_teledyne;
+
+/** Count of gaps listed per file */
+static const size_t LISTED_GAPS = 20;
+
+void usage()
+{
+    std::cerr << "dvl_teledyne_stats [-j THREADS] FILE..." << std::endl;
+    std::cerr << "  computes per-beam statistics over PD0 recordings, e.g. the" << std::endl;
+    std::cerr << "  .pd0 files written by dvl_teledyne_recorder. Files are analyzed" << std::endl;
+    std::cerr << "  in the order given, and the sequence gaps between them are reported" << std::endl;
+}
+
+static double percent(uint64_t value, uint64_t total)
+{
+    return total ? 100.0 * value / total : 0;
+}
+
+static void printHistogram(std::string const& name, Histogram const& histogram, int precision)
+{
+    uint64_t total = histogram.count();
+    std::cout << "    " << name << " (" << total << " values)" << std::endl;
+    if (!total)
+        return;
+
+    std::cout << std::fixed << std::setprecision(precision);
+    for (size_t i = 0; i < histogram.bins.size(); ++i)
+    {
+        if (!histogram.bins[i])
+            continue;
+        double ratio = static_cast<double>(histogram.bins[i]) / total;
+        std::cout << "      [" << std::setw(6) << histogram.min + histogram.bin_width * i
+            << ", " << std::setw(6) << histogram.min + histogram.bin_width * (i + 1) << ") "
+            << std::setw(6) << std::setprecision(2) << 100 * ratio << "% "
+            << std::string(static_cast<size_t>(50 * ratio), '#') << std::endl;
+        std::cout << std::setprecision(precision);
+    }
+    if (histogram.overflow)
+        std::cout << "      overflow " << histogram.overflow << std::endl;
+}
+
+static void printQuantiles(std::string const& name, Histogram const& histogram)
+{
+    std::cout << "    " << name << std::fixed << std::setprecision(2)
+        << ": p5 " << histogram.quantile(0.05)
+        << " median " << histogram.quantile(0.5)
+        << " p95 " << histogram.quantile(0.95)
+        << " (" << histogram.count() << " values)" << std::endl;
+}
+
+static void printGaps(RecordingStatistics const& stats)
+{
+    for (size_t i = 0; i < stats.gaps.size() && i < LISTED_GAPS; ++i)
+    {
+        SequenceGap const& gap = stats.gaps[i];
+        std::cout << "    at byte " << gap.offset << ": " << gap.last_seq << " -> " << gap.next_seq;
+        if (gap.next_seq <= gap.last_seq)
+            std::cout << " (restart)";
+        std::cout << std::endl;
+    }
+    if (stats.sequence_gaps > LISTED_GAPS)
+        std::cout << "    ... " << stats.sequence_gaps - LISTED_GAPS << " more" << std::endl;
+}
+
+int main(int argc, char const* argv[])
+{
+    int thread_count = std::thread::hardware_concurrency();
+    int first_file = 1;
+    if (argc > 2 && !strcmp(argv[1], "-j"))
+    {
+        thread_count = atoi(argv[2]);
+        first_file = 3;
+    }
+    if (first_file >= argc || thread_count < 1)
+    {
+        usage();
+        return 1;
+    }
+
+    RecordingStatistics total;
+    for (int i = first_file; i < argc; ++i)
+    {
+        RecordingStatistics stats;
+        try { stats = RecordingStatistics::analyzeFile(argv[i], thread_count); }
+        catch(std::runtime_error const& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+
+        std::cout << argv[i] << ": " << stats.ensembles << " ensembles, "
+            << stats.decode_errors << " decode errors, "
+            << stats.discarded_bytes << " bytes discarded, "
+            << stats.sequence_gaps << " sequence gaps" << std::endl;
+        printGaps(stats);
+        total.merge(stats);
+    }
+
+    std::cout << std::endl << "Total: " << total.ensembles << " ensembles in "
+        << total.bytes << " bytes";
+    if (total.ensembles)
+    {
+        std::cout << std::fixed << std::setprecision(1) << ", "
+            << (total.last_time - total.first_time).toSeconds() << " s from seq "
+            << total.first_seq << " to " << total.last_seq;
+    }
+    std::cout << std::endl;
+    std::cout << "  decode errors: " << total.decode_errors << std::endl;
+    std::cout << "  discarded bytes: " << total.discarded_bytes << std::endl;
+    std::cout << "  sequence gaps: " << total.sequence_gaps << ", "
+        << total.lost_ensembles << " ensembles lost, "
+        << total.restarts << " restarts" << std::endl;
+    std::cout << std::fixed << std::setprecision(1)
+        << "  bottom lock: " << percent(total.three_beam_lock, total.ensembles) << "% on 3 beams or more, "
+        << percent(total.four_beam_lock, total.ensembles) << "% on 4 beams" << std::endl;
+
+    for (int beam = 0; beam < 4; ++beam)
+    {
+        BeamStatistics const& stats = total.beams[beam];
+        std::cout << std::endl << "  Beam " << beam << std::fixed << std::setprecision(1)
+            << ": bottom lock " << percent(stats.bottom_lock, total.ensembles) << "%" << std::endl;
+        printQuantiles("range (m)", stats.range);
+        printHistogram("correlation", stats.correlation, 2);
+        printHistogram("RSSI (dB)", stats.rssi, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,546 @@
+#ifndef DVL_TELEDYNE_PD0FIELDS_HPP
+#define DVL_TELEDYNE_PD0FIELDS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <ratio>
+#include <type_traits>
+#include <base/Float.hpp>
+
+#include <dvl_teledyne/PD0Messages.hpp>
+#include <dvl_teledyne/PD0Raw.hpp>
+
+namespace dvl_teledyne
+{
+    /** Compile-time description of the PD0 fields
+     *
+     * Each decoded value is described by one line of a table, which gives
+     * where the raw value is (the encoding: offset, width and byte order),
+     * how it is converted (a scale factor, or a special conversion for
+     * bitfields, times and attitude) and which raw value marks it as invalid
+     * (the sentinel). The decoders are generated from the tables at compile
+     * time, and compile down to a sequence of loads, multiplications and
+     * stores with no per-field dispatch.
+     *
+     * To decode a new field, add it to the structure in PD0Messages.hpp and
+     * add one line to the corresponding table at the end of this file
+     */
+    namespace fields
+    {
+        /** Calls op(0), op(1), ... op(Count - 1), fully unrolled at compile
+         * time
+         */
+        template<size_t Count, size_t I = 0>
+        struct Unroll
+        {
+            template<typename Op>
+            static void run(Op const& op)
+            {
+                op(I);
+                Unroll<Count, I + 1>::run(op);
+            }
+        };
+
+        template<size_t Count>
+        struct Unroll<Count, Count>
+        {
+            template<typename Op>
+            static void run(Op const&) {}
+        };
+
+        enum BYTE_ORDERS
+        {
+            LSB_FIRST, MSB_FIRST
+        };
+
+        /** Encodings
+         *
+         * An encoding defines the raw type of a field and how to read it. The
+         * i-th element of array fields is read with read(msg, i), and
+         * end(count) is the offset of the first byte after \c count
+         * elements
+         */
+
+        /** Integer of type T at \c Offset. Elements of arrays are contiguous
+         */
+        template<typename T, size_t Offset, BYTE_ORDERS Order = LSB_FIRST>
+        struct Integer
+        {
+            typedef T type;
+            typedef typename std::make_unsigned<T>::type unsigned_type;
+
+            static constexpr size_t end(size_t count) { return Offset + count * sizeof(T); }
+            static T read(uint8_t const* msg, size_t index)
+            {
+                // Assembled byte by byte, which is alignment-safe. The
+                // compiler turns it into a single load
+                uint8_t const* bytes = msg + Offset + index * sizeof(T);
+                unsigned_type value = 0;
+                for (size_t i = 0; i < sizeof(T); ++i)
+                {
+                    size_t shift = 8 * (Order == LSB_FIRST ? i : sizeof(T) - 1 - i);
+                    value |= static_cast<unsigned_type>(static_cast<unsigned_type>(bytes[i]) << shift);
+                }
+                return static_cast<T>(value);
+            }
+        };
+
+        /** Unsigned integer split in two parts, e.g. the low 16 bits and high
+         * 8 bits of the bottom ranges
+         */
+        template<typename Low, typename High>
+        struct Split
+        {
+            typedef uint32_t type;
+
+            static constexpr size_t end(size_t count)
+            {
+                return Low::end(count) > High::end(count) ? Low::end(count) : High::end(count);
+            }
+            static uint32_t read(uint8_t const* msg, size_t index)
+            {
+                return static_cast<uint32_t>(Low::read(msg, index)) |
+                    (static_cast<uint32_t>(High::read(msg, index)) << (8 * sizeof(typename Low::type)));
+            }
+        };
+
+        /** Duration stored as three bytes (minutes, seconds, hundredths of
+         * seconds), read as a count of hundredths of seconds
+         */
+        template<size_t Offset>
+        struct Duration
+        {
+            typedef uint32_t type;
+
+            static constexpr size_t end(size_t) { return Offset + 3; }
+            static uint32_t read(uint8_t const* msg, size_t)
+            {
+                uint8_t const* bytes = msg + Offset;
+                return static_cast<uint32_t>(bytes[0]) * 6000 + bytes[1] * 100 + bytes[2];
+            }
+        };
+
+        /** Yaw, pitch and roll read from three fields */
+        template<typename Yaw, typename Pitch, typename Roll>
+        struct Angles
+        {
+            typedef Eigen::Vector3d type;
+
+            static constexpr size_t end(size_t)
+            {
+                return Yaw::end(1) > Pitch::end(1) ?
+                    (Yaw::end(1) > Roll::end(1) ? Yaw::end(1) : Roll::end(1)) :
+                    (Pitch::end(1) > Roll::end(1) ? Pitch::end(1) : Roll::end(1));
+            }
+            static Eigen::Vector3d read(uint8_t const* msg, size_t)
+            {
+                return Eigen::Vector3d(
+                        static_cast<double>(Yaw::read(msg, 0)),
+                        static_cast<double>(Pitch::read(msg, 0)),
+                        static_cast<double>(Roll::read(msg, 0)));
+            }
+        };
+
+        /** Broken-down date and time from the device real-time clock */
+        struct RtcReading
+        {
+            uint8_t century;
+            uint8_t year;
+            uint8_t month;
+            uint8_t day;
+            uint8_t hour;
+            uint8_t min;
+            uint8_t sec;
+            uint8_t hundredth;
+        };
+
+        /** Real-time clock of the variable leader
+         *
+         * The Y2K-compliant clock (century, year, month, day, hour, minute,
+         * second, hundredth) is used when the device reports it, i.e. when
+         * its century is not zero. Otherwise, the legacy clock (two-digit
+         * year, month, day, hour, minute, second, hundredth) is read and the
+         * date is assumed to be in the 21st century
+         */
+        template<size_t Y2KOffset, size_t LegacyOffset>
+        struct Rtc
+        {
+            typedef RtcReading type;
+
+            static constexpr size_t end(size_t)
+            {
+                return Y2KOffset + 8 > LegacyOffset + 7 ? Y2KOffset + 8 : LegacyOffset + 7;
+            }
+            static RtcReading read(uint8_t const* msg, size_t)
+            {
+                // The legacy clock is the Y2K one without the century byte
+                uint8_t const* y2k = msg + Y2KOffset;
+                uint8_t const* legacy = msg + LegacyOffset - 1;
+                uint8_t const* clock = y2k[0] ? y2k : legacy;
+
+                RtcReading rtc;
+                rtc.century   = y2k[0] ? y2k[0] : 20;
+                rtc.year      = clock[1];
+                rtc.month     = clock[2];
+                rtc.day       = clock[3];
+                rtc.hour      = clock[4];
+                rtc.min       = clock[5];
+                rtc.sec       = clock[6];
+                rtc.hundredth = clock[7];
+                return rtc;
+            }
+        };
+
+        /** Conversions
+         *
+         * A conversion turns a raw value into the type of the field it is
+         * stored in with apply<Out>(raw)
+         */
+
+        struct Identity
+        {
+            template<typename Out, typename Raw>
+            static Out apply(Raw raw) { return static_cast<Out>(raw); }
+        };
+
+        /** Bias + Scale * raw, where both are std::ratio */
+        template<typename Scale, typename Bias = std::ratio<0> >
+        struct Linear
+        {
+            template<typename Out, typename Raw>
+            static Out apply(Raw raw)
+            {
+                return static_cast<Out>(Bias::num) / Bias::den +
+                    static_cast<Out>(Scale::num) / Scale::den * raw;
+            }
+        };
+
+        /** Angle in units of \c Scale degrees, converted to radians */
+        template<typename Scale>
+        struct Radians
+        {
+            template<typename Out, typename Raw>
+            static Out apply(Raw raw)
+            {
+                return static_cast<Out>(M_PI / 180 * Scale::num / Scale::den) * raw;
+            }
+        };
+
+        /** True if any bit of \c Mask is set */
+        template<uintmax_t Mask>
+        struct Flag
+        {
+            template<typename Out, typename Raw>
+            static Out apply(Raw raw) { return (raw & Mask) != 0; }
+        };
+
+        /** Bits of \c Mask shifted right by \c Shift, cast to an enum */
+        template<uintmax_t Mask, unsigned int Shift>
+        struct BitField
+        {
+            template<typename Out, typename Raw>
+            static Out apply(Raw raw) { return static_cast<Out>((raw & Mask) >> Shift); }
+        };
+
+        /** Sensors bitfield, see raw::PD0_SENSORS */
+        struct SensorSet
+        {
+            template<typename Out, typename Raw>
+            static Out apply(Raw bits)
+            {
+                Sensors result;
+                result.calculates_speed_of_sound = bits & raw::PD0_CALCULATE_SPEED_OF_SOUND;
+                result.depth       = bits & raw::PD0_DEPTH_SENSOR;
+                result.yaw         = bits & raw::PD0_YAW_SENSOR;
+                result.pitch       = bits & raw::PD0_PITCH_SENSOR;
+                result.roll        = bits & raw::PD0_ROLL_SENSOR;
+                result.salinity    = bits & raw::PD0_SALINITY_SENSOR;
+                result.temperature = bits & raw::PD0_TEMPERATURE_SENSOR;
+                return result;
+            }
+        };
+
+        /** Duration in hundredths of seconds, as read by Duration */
+        struct Hundredths
+        {
+            template<typename Out, typename Raw>
+            static Out apply(Raw raw) { return base::Time::fromMicroseconds(static_cast<int64_t>(raw) * 10000); }
+        };
+
+        /** Yaw, pitch and roll in hundredths of degrees, as read by Angles */
+        struct Orientation
+        {
+            template<typename Out, typename Raw>
+            static Out apply(Raw const& ypr)
+            {
+                double const scale = M_PI / 180 * 0.01;
+                return Out(
+                    Eigen::AngleAxisd(scale * ypr[2], Eigen::Vector3d::UnitX()) *
+                    Eigen::AngleAxisd(scale * ypr[1], Eigen::Vector3d::UnitY()) *
+                    Eigen::AngleAxisd(scale * ypr[0], Eigen::Vector3d::UnitZ()));
+            }
+        };
+
+        /** UTC time, as read by Rtc */
+        struct UtcTime
+        {
+            template<typename Out, typename Raw>
+            static Out apply(Raw const& rtc)
+            {
+                tm date = tm();
+                date.tm_year = rtc.century * 100 + rtc.year - 1900;
+                date.tm_mon  = rtc.month - 1;
+                date.tm_mday = rtc.day;
+                date.tm_hour = rtc.hour;
+                date.tm_min  = rtc.min;
+                date.tm_sec  = rtc.sec;
+                return base::Time::fromSeconds(timegm(&date), static_cast<uint64_t>(rtc.hundredth) * 10000);
+            }
+        };
+
+        /** Sentinels
+         *
+         * A sentinel tells whether a raw value marks the field as invalid, in
+         * which case the field is set to invalid<Out>() instead of being
+         * converted
+         */
+
+        struct NoSentinel
+        {
+            template<typename Raw>
+            static constexpr bool matches(Raw const&) { return false; }
+            template<typename Out>
+            static Out invalid() { return Out(); }
+        };
+
+        template<intmax_t Value>
+        struct Sentinel
+        {
+            template<typename Raw>
+            static constexpr bool matches(Raw raw) { return raw == Value; }
+            template<typename Out>
+            static Out invalid() { return base::unknown<Out>(); }
+        };
+
+        template<typename Out, typename Encoding, typename Conversion, typename Sentinel>
+        Out decodeValue(uint8_t const* msg, size_t index)
+        {
+            typename Encoding::type raw = Encoding::read(msg, index);
+            if (Sentinel::matches(raw))
+                return Sentinel::template invalid<Out>();
+            return Conversion::template apply<Out>(raw);
+        }
+
+        /** Descriptor of a field, stored in \c Member
+         *
+         * If \c Member is an array, all its elements are decoded from
+         * consecutive raw elements
+         */
+        template<typename MemberPtr, MemberPtr Member, typename Encoding,
+            typename Conversion = Identity, typename Sentinel = NoSentinel>
+        struct Field;
+
+        template<typename Target, typename T, T Target::*Member,
+            typename Encoding, typename Conversion, typename Sentinel>
+        struct Field<T Target::*, Member, Encoding, Conversion, Sentinel>
+        {
+            static constexpr size_t END = Encoding::end(1);
+
+            static void decode(uint8_t const* msg, Target& target)
+            {
+                target.*Member = decodeValue<T, Encoding, Conversion, Sentinel>(msg, 0);
+            }
+        };
+
+        template<typename Target, typename T, size_t N, T (Target::*Member)[N],
+            typename Encoding, typename Conversion, typename Sentinel>
+        struct Field<T (Target::*)[N], Member, Encoding, Conversion, Sentinel>
+        {
+            static constexpr size_t END = Encoding::end(N);
+
+            static void decode(uint8_t const* msg, Target& target)
+            {
+                T* out = target.*Member;
+                Unroll<N>::run([msg, out](size_t i)
+                {
+                    out[i] = decodeValue<T, Encoding, Conversion, Sentinel>(msg, i);
+                });
+            }
+        };
+
+        /** Descriptor of a field stored in one element of the \c Member
+         * array
+         */
+        template<typename MemberPtr, MemberPtr Member, size_t Index, typename Encoding,
+            typename Conversion = Identity, typename Sentinel = NoSentinel>
+        struct Element;
+
+        template<typename Target, typename T, size_t N, T (Target::*Member)[N], size_t Index,
+            typename Encoding, typename Conversion, typename Sentinel>
+        struct Element<T (Target::*)[N], Member, Index, Encoding, Conversion, Sentinel>
+        {
+            static_assert(Index < N, "element index out of bounds");
+            static constexpr size_t END = Encoding::end(1);
+
+            static void decode(uint8_t const* msg, Target& target)
+            {
+                (target.*Member)[Index] = decodeValue<T, Encoding, Conversion, Sentinel>(msg, 0);
+            }
+        };
+
+        /** List of the fields decoded from one message into one structure
+         *
+         * It is checked at compile time that all fields are within
+         * sizeof(Message), so the caller only has to validate the message
+         * size before calling decode
+         */
+        template<typename Message, typename... Fields>
+        struct Table;
+
+        template<typename Message>
+        struct Table<Message>
+        {
+            template<typename Target>
+            static void decode(uint8_t const*, Target&) {}
+        };
+
+        template<typename Message, typename Head, typename... Tail>
+        struct Table<Message, Head, Tail...>
+        {
+            static_assert(Head::END <= sizeof(Message), "field outside of its message");
+
+            template<typename Target>
+            static void decode(uint8_t const* msg, Target& target)
+            {
+                Head::decode(msg, target);
+                Table<Message, Tail...>::decode(msg, target);
+            }
+        };
+
+        typedef std::ratio<1, 255> PerByte;
+        typedef std::ratio<45, 100> IntensityScale;
+        /** The pressure fields are in decapascals */
+        typedef Linear< std::ratio<10>, std::ratio<100> > Pressure;
+
+/** Integer encoding of raw::Message::field, whose width and signedness are
+ * the ones of the raw structure
+ */
+#define PD0_AT(Message, field) \
+    Integer<std::remove_extent<decltype(raw::Message::field)>::type, offsetof(raw::Message, field)>
+#define PD0_FIELD(member, ...) \
+    Field<decltype(&member), &member, __VA_ARGS__>
+#define PD0_ELEMENT(member, index, ...) \
+    Element<decltype(&member), &member, index, __VA_ARGS__>
+
+        typedef Table< raw::FixedLeader,
+            PD0_FIELD(DeviceInfo::fw_version,           PD0_AT(FixedLeader, fw_version)),
+            PD0_FIELD(DeviceInfo::fw_revision,          PD0_AT(FixedLeader, fw_revision)),
+            PD0_FIELD(DeviceInfo::cpu_board_serno,      PD0_AT(FixedLeader, cpu_board_serno)),
+            PD0_FIELD(DeviceInfo::system_configuration, PD0_AT(FixedLeader, system_configuration)),
+            PD0_FIELD(DeviceInfo::beam_count,           PD0_AT(FixedLeader, beam_count)),
+            PD0_FIELD(DeviceInfo::available_sensors,    PD0_AT(FixedLeader, available_sensors), SensorSet)
+            > DeviceInfoTable;
+
+        typedef Duration< offsetof(raw::FixedLeader, time_between_ping_groups_min) > TimeBetweenPingGroups;
+
+        typedef Table< raw::FixedLeader,
+            PD0_FIELD(AcquisitionConfiguration::used_sensors,           PD0_AT(FixedLeader, used_sensors), SensorSet),
+            PD0_FIELD(AcquisitionConfiguration::lag_duration,           PD0_AT(FixedLeader, lag_duration)),
+            PD0_FIELD(AcquisitionConfiguration::cell_count,             PD0_AT(FixedLeader, cell_count)),
+            PD0_FIELD(AcquisitionConfiguration::profiling_mode,         PD0_AT(FixedLeader, profiling_mode)),
+            PD0_FIELD(AcquisitionConfiguration::low_correlation_threshold, PD0_AT(FixedLeader, low_correlation_threshold)),
+            PD0_FIELD(AcquisitionConfiguration::code_repetition_count,  PD0_AT(FixedLeader, code_repetition_count)),
+            PD0_FIELD(AcquisitionConfiguration::pings_per_ensemble,     PD0_AT(FixedLeader, pings_per_ensemble)),
+            PD0_FIELD(AcquisitionConfiguration::cell_length,            PD0_AT(FixedLeader, cell_length), Linear<std::centi>),
+            PD0_FIELD(AcquisitionConfiguration::blank_after_transmit_distance, PD0_AT(FixedLeader, blank_after_transmit_distance), Linear<std::centi>),
+            PD0_FIELD(AcquisitionConfiguration::water_layer_min_ping_threshold, PD0_AT(FixedLeader, water_layer_min_ping_threshold), Linear<PerByte>),
+            PD0_FIELD(AcquisitionConfiguration::water_layer_velocity_threshold, PD0_AT(FixedLeader, water_layer_velocity_threshold), Linear<std::milli>),
+            PD0_FIELD(AcquisitionConfiguration::time_between_ping_groups, TimeBetweenPingGroups, Hundredths),
+            PD0_FIELD(AcquisitionConfiguration::yaw_alignment,          PD0_AT(FixedLeader, yaw_alignment), Radians<std::centi>),
+            PD0_FIELD(AcquisitionConfiguration::yaw_bias,               PD0_AT(FixedLeader, yaw_bias), Radians<std::centi>),
+            PD0_FIELD(AcquisitionConfiguration::first_cell_distance,    PD0_AT(FixedLeader, first_cell_distance), Linear<std::centi>),
+            PD0_FIELD(AcquisitionConfiguration::transmit_pulse_length,  PD0_AT(FixedLeader, transmit_pulse_length), Linear<std::centi>),
+            PD0_FIELD(AcquisitionConfiguration::water_layer_start,      PD0_AT(FixedLeader, water_layer_start)),
+            PD0_FIELD(AcquisitionConfiguration::water_layer_end,        PD0_AT(FixedLeader, water_layer_end)),
+            PD0_FIELD(AcquisitionConfiguration::false_target_threshold, PD0_AT(FixedLeader, false_target_threshold)),
+            PD0_FIELD(AcquisitionConfiguration::low_latency_trigger,    PD0_AT(FixedLeader, low_latency_trigger)),
+            PD0_FIELD(AcquisitionConfiguration::transmit_lag_distance,  PD0_AT(FixedLeader, transmit_lag_distance), Linear<std::centi>),
+            PD0_FIELD(AcquisitionConfiguration::narrow_bandwidth_mode,  PD0_AT(FixedLeader, narrow_bandwidth_mode)),
+            PD0_FIELD(AcquisitionConfiguration::base_frequency_index,   PD0_AT(FixedLeader, base_frequency_index)),
+            PD0_FIELD(AcquisitionConfiguration::simulated_data,         PD0_AT(FixedLeader, simulated_data))
+            > AcquisitionConfigurationTable;
+
+        typedef Table< raw::FixedLeader,
+            PD0_FIELD(OutputConfiguration::coordinate_system,  PD0_AT(FixedLeader, coordinate_transformation_mode),
+                    BitField<raw::PD0_COORDINATE_SYSTEM_MASK, 3>),
+            PD0_FIELD(OutputConfiguration::use_attitude,       PD0_AT(FixedLeader, coordinate_transformation_mode),
+                    Flag<raw::PD0_USE_ATTITUDE>),
+            PD0_FIELD(OutputConfiguration::use_3beam_solution, PD0_AT(FixedLeader, coordinate_transformation_mode),
+                    Flag<raw::PD0_USE_3BEAM_SOLUTION>),
+            PD0_FIELD(OutputConfiguration::use_bin_mapping,    PD0_AT(FixedLeader, coordinate_transformation_mode),
+                    Flag<raw::PD0_USE_BIN_MAPPING>)
+            > OutputConfigurationTable;
+
+        typedef Split< PD0_AT(VariableLeader, seq_low), PD0_AT(VariableLeader, seq_high) > EnsembleNumber;
+        typedef Rtc< offsetof(raw::VariableLeader, y2k_rtc_century), offsetof(raw::VariableLeader, rtc_year) > RealTimeClock;
+        typedef Angles< PD0_AT(VariableLeader, yaw), PD0_AT(VariableLeader, pitch), PD0_AT(VariableLeader, roll) > Attitude;
+        typedef Duration< offsetof(raw::VariableLeader, min_preping_wait_duration_min) > MinPrepingWait;
+
+        typedef Table< raw::VariableLeader,
+            PD0_FIELD(Status::seq,               EnsembleNumber),
+            PD0_FIELD(Status::time,              RealTimeClock, UtcTime),
+            PD0_FIELD(Status::orientation,       Attitude, Orientation),
+            PD0_ELEMENT(Status::stddev_orientation, 0, PD0_AT(VariableLeader, stddev_yaw), Radians< std::ratio<1> >),
+            PD0_ELEMENT(Status::stddev_orientation, 1, PD0_AT(VariableLeader, stddev_pitch), Radians<std::deci>),
+            PD0_ELEMENT(Status::stddev_orientation, 2, PD0_AT(VariableLeader, stddev_roll), Radians<std::deci>),
+            PD0_FIELD(Status::depth,             PD0_AT(VariableLeader, depth_of_transducer), Linear<std::deci>),
+            PD0_FIELD(Status::speed_of_sound,    PD0_AT(VariableLeader, speed_of_sound)),
+            PD0_FIELD(Status::salinity,          PD0_AT(VariableLeader, salinity_at_transducer), Linear<std::milli>),
+            PD0_FIELD(Status::temperature,       PD0_AT(VariableLeader, temperature_at_transducer), Linear<std::centi>),
+            PD0_FIELD(Status::pressure,          PD0_AT(VariableLeader, pressure_at_transducer), Pressure),
+            PD0_FIELD(Status::pressure_variance, PD0_AT(VariableLeader, pressure_variance_at_transducer), Pressure),
+            PD0_FIELD(Status::adc_channels,      PD0_AT(VariableLeader, adc_channels)),
+            PD0_FIELD(Status::min_preping_wait,  MinPrepingWait, Hundredths),
+            PD0_FIELD(Status::self_test_result,  PD0_AT(VariableLeader, self_test_result)),
+            PD0_FIELD(Status::status_word,       PD0_AT(VariableLeader, status_word))
+            > StatusTable;
+
+        typedef Table< raw::BottomTrackingMessage,
+            PD0_FIELD(BottomTrackingConfiguration::ping_per_ensemble,        PD0_AT(BottomTrackingMessage, bottom_ping_per_ensemble)),
+            PD0_FIELD(BottomTrackingConfiguration::delay_before_reacquiring, PD0_AT(BottomTrackingMessage, bottom_delay_before_reacquiring)),
+            PD0_FIELD(BottomTrackingConfiguration::correlation_threshold,    PD0_AT(BottomTrackingMessage, bottom_correlation_threshold), Linear<PerByte>),
+            PD0_FIELD(BottomTrackingConfiguration::evaluation_threshold,     PD0_AT(BottomTrackingMessage, bottom_evaluation_threshold), Linear<PerByte>),
+            PD0_FIELD(BottomTrackingConfiguration::good_ping_threshold,      PD0_AT(BottomTrackingMessage, bottom_good_ping_threshold), Linear<std::centi>),
+            PD0_FIELD(BottomTrackingConfiguration::mode,                     PD0_AT(BottomTrackingMessage, bottom_mode)),
+            PD0_FIELD(BottomTrackingConfiguration::max_velocity_error,       PD0_AT(BottomTrackingMessage, bottom_max_velocity_error), Linear<std::milli>),
+            PD0_FIELD(BottomTrackingConfiguration::max_tracking_depth,       PD0_AT(BottomTrackingMessage, max_tracking_depth), Linear<std::deci>),
+            PD0_FIELD(BottomTrackingConfiguration::gain,                     PD0_AT(BottomTrackingMessage, gain)),
+            PD0_FIELD(BottomTrackingConfiguration::water_layer_min_size,     PD0_AT(BottomTrackingMessage, water_layer_min_size), Linear<std::deci>),
+            PD0_FIELD(BottomTrackingConfiguration::water_layer_near_boundary, PD0_AT(BottomTrackingMessage, water_layer_near_boundary), Linear<std::deci>),
+            PD0_FIELD(BottomTrackingConfiguration::water_layer_far_boundary, PD0_AT(BottomTrackingMessage, water_layer_far_boundary), Linear<std::deci>)
+            > BottomTrackingConfigurationTable;
+
+        typedef Split< PD0_AT(BottomTrackingMessage, bottom_range_low), PD0_AT(BottomTrackingMessage, bottom_range_high) > BottomRange;
+
+        typedef Table< raw::BottomTrackingMessage,
+            PD0_FIELD(BottomTracking::range,           BottomRange, Linear<std::centi>, Sentinel<0>),
+            PD0_FIELD(BottomTracking::velocity,        PD0_AT(BottomTrackingMessage, bottom_velocity), Linear<std::milli>, Sentinel<-32768>),
+            PD0_FIELD(BottomTracking::correlation,     PD0_AT(BottomTrackingMessage, bottom_correlation), Linear<PerByte>),
+            PD0_FIELD(BottomTracking::evaluation,      PD0_AT(BottomTrackingMessage, bottom_evaluation), Linear<PerByte>),
+            PD0_FIELD(BottomTracking::good_ping_ratio, PD0_AT(BottomTrackingMessage, bottom_good_ping_ratio), Linear<std::centi>),
+            PD0_FIELD(BottomTracking::rssi,            PD0_AT(BottomTrackingMessage, rssi), Linear<IntensityScale>),
+            PD0_FIELD(BottomTracking::water_layer_velocity,    PD0_AT(BottomTrackingMessage, water_layer_velocity), Linear<std::milli>, Sentinel<-32768>),
+            PD0_FIELD(BottomTracking::water_layer_correlation, PD0_AT(BottomTrackingMessage, water_layer_correlation_magnitude), Linear<PerByte>),
+            PD0_FIELD(BottomTracking::water_layer_intensity,   PD0_AT(BottomTrackingMessage, water_layer_intensity), Linear<IntensityScale>),
+            PD0_FIELD(BottomTracking::water_layer_good_ping_ratio, PD0_AT(BottomTrackingMessage, water_layer_quality), Linear<std::centi>)
+            > BottomTrackingTable;
+
+#undef PD0_ELEMENT
+#undef PD0_FIELD
+#undef PD0_AT
+    }
+}
+
+#endif
+
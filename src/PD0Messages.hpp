@@ -91,6 +91,8 @@ namespace dvl_teledyne
         bool  narrow_bandwidth_mode;
         /** ? */
         uint8_t  base_frequency_index;
+        /** If true, the device outputs simulated data */
+        bool  simulated_data;
     };
 
     enum COORDINATE_SYSTEMS
@@ -128,10 +130,17 @@ namespace dvl_teledyne
 
         base::Time min_preping_wait;
 
+        /** Result of the built-in test, zero if all tests passed */
         uint16_t self_test_result;
+        /** Health and wakeup state of the device, as a combination of
+         * raw::PD0_STATUS_FLAGS
+         */
         uint32_t status_word;
     };
 
+    /** Data of one depth cell. On 3-beam devices, the values of the
+     * fourth beam are NaN
+     */
     struct CellReading
     {
         /** Velocity. The meaning of the four values depend on the
@@ -200,6 +209,17 @@ namespace dvl_teledyne
          * See the WJ command
          */
         uint8_t  gain;
+
+        /** Minimum size of the water reference layer, in meters */
+        float water_layer_min_size;
+        /** Start of the water reference layer, as a distance from the
+         * transducer in meters
+         */
+        float water_layer_near_boundary;
+        /** End of the water reference layer, as a distance from the
+         * transducer in meters
+         */
+        float water_layer_far_boundary;
     };
 
     /** Bottom tracking information */
@@ -220,12 +240,40 @@ namespace dvl_teledyne
         float correlation[4];
         /** Magnitude in the evaluation filter, for each beam */
         float evaluation[4];
-        /** Ratio of good bottom tracking pings */
+        /** Ratio of good bottom tracking pings (between 0 and 1) */
         float good_ping_ratio[4];
 
         /** RSSI at the center of the bottom ping (in dB)
          */
         float rssi[4];
+
+        /** Velocity of the water reference layer. It is reported in the
+         * same coordinate system as \c velocity
+         */
+        float water_layer_velocity[4];
+        /** Correlation in the water reference layer (between 0 and 1) */
+        float water_layer_correlation[4];
+        /** Echo intensity in the water reference layer (in dB) */
+        float water_layer_intensity[4];
+        /** Ratio of good pings in the water reference layer */
+        float water_layer_good_ping_ratio[4];
+    };
+
+    /** All the information decoded from one PD0 ensemble */
+    struct Ensemble
+    {
+        /** Incremented each time deviceInfo, acqConf or outputConf change. Use
+         * it to update values that depend on the device configuration
+         */
+        uint32_t configuration_version;
+
+        DeviceInfo deviceInfo;
+        AcquisitionConfiguration acqConf;
+        OutputConfiguration outputConf;
+        Status status;
+        CellReadings cellReadings;
+        BottomTrackingConfiguration bottomTrackingConf;
+        BottomTracking bottomTracking;
     };
 }
 
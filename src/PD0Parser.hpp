@@ -7,25 +7,85 @@
 #include <vector>
 
 #include <dvl_teledyne/PD0Messages.hpp>
+#include <dvl_teledyne/PD0Raw.hpp>
+#include <dvl_teledyne/LinkStatistics.hpp>
 
 namespace dvl_teledyne
 {
+    /** Result of the decoding of an ensemble, or of one of its messages */
+    enum PARSE_STATUS
+    {
+        PARSE_OK,
+        /** The buffer is too small for the ensemble header and message
+         * offsets */
+        PARSE_TRUNCATED_HEADER,
+        /** A message offset points outside of the ensemble */
+        PARSE_INVALID_OFFSET,
+        /** A message is too small for its expected content */
+        PARSE_TRUNCATED_MESSAGE,
+        /** A depth cell message got received before any fixed leader */
+        PARSE_MISSING_FIXED_LEADER,
+        /** A field has a value that is not allowed by the PD0 format */
+        PARSE_INVALID_VALUE
+    };
+
+    /** Returns a static string describing \c status */
+    char const* parseStatusToString(PARSE_STATUS status);
+
+    /** Sets all the per-beam values of \c tracking to unknown, so that an
+     * ensemble that does not report them does not keep the previous ones
+     */
+    void invalidateBottomTracking(BottomTracking& tracking);
+
     class PD0Parser
     {
+        friend class Pipeline;
+
     protected:
+        /** Link health counters, updated by extractPacket and parseEnsemble */
+        mutable LinkStatistics mLinkStats;
+
         int extractPacket(uint8_t const* buffer, size_t size, size_t max_size = 0) const;
         int getSizeOfMessage(uint16_t msg_id) const;
         void invalidateCellReadings();
-        void parseMessage(uint8_t const* buffer, size_t size);
-        void parseFixedLeader(uint8_t const* buffer, size_t size);
-        void parseVariableLeader(uint8_t const* buffer, size_t size);
-        void parseQualityReadings(uint8_t const* buffer, size_t size);
-        void parseCorrelationReadings(uint8_t const* buffer, size_t size);
-        void parseIntensityReadings(uint8_t const* buffer, size_t size);
-        void parseVelocityReadings(uint8_t const* buffer, size_t size);
-        void parseBottomTrackingReadings(uint8_t const* buffer, size_t size);
+        PARSE_STATUS parseMessage(uint8_t const* buffer, size_t size);
+        PARSE_STATUS parseFixedLeader(uint8_t const* buffer, size_t size);
+        PARSE_STATUS parseVariableLeader(uint8_t const* buffer, size_t size);
+        PARSE_STATUS parseQualityReadings(uint8_t const* buffer, size_t size);
+        PARSE_STATUS parseCorrelationReadings(uint8_t const* buffer, size_t size);
+        PARSE_STATUS parseIntensityReadings(uint8_t const* buffer, size_t size);
+        PARSE_STATUS parseVelocityReadings(uint8_t const* buffer, size_t size);
+        PARSE_STATUS parseBottomTrackingReadings(uint8_t const* buffer, size_t size);
+
+        /** Status of each message of the last ensemble passed to
+         * tryParseEnsemble */
+        std::vector<PARSE_STATUS> mMessageStatus;
+
+        /** Raw bytes of the last fixed leader that got decoded. The fixed
+         * leader is decoded only when these bytes change
+         */
+        uint8_t mFixedLeader[sizeof(raw::FixedLeader)];
+        bool mHasFixedLeader;
+        uint32_t mConfigurationVersion;
+        bool mConfigurationChanged;
+
+        /** Count of beams in the depth cell messages, as derived from
+         * deviceInfo.beam_count. The depth cell decoders are specialized for
+         * each supported value. Zero if the beam count is not supported
+         */
+        int mCellBeamCount;
+
+        /** Called at the end of tryParseEnsemble when the fixed leader of
+         * the ensemble differs from the previous one, i.e. when deviceInfo,
+         * acqConf or outputConf changed
+         *
+         * The default implementation does nothing
+         */
+        virtual void configurationChanged();
 
     public:
+        PD0Parser();
+        virtual ~PD0Parser();
 
         DeviceInfo deviceInfo;
         AcquisitionConfiguration acqConf;
@@ -35,7 +95,72 @@ namespace dvl_teledyne
         BottomTrackingConfiguration bottomTrackingConf;
         BottomTracking bottomTracking;
 
+        /** Decodes an ensemble
+         *
+         * Throws std::runtime_error if the ensemble is malformed. This is a
+         * wrapper around tryParseEnsemble
+         */
         void parseEnsemble(uint8_t const* data, size_t size);
+
+        /** Decodes an ensemble, without throwing
+         *
+         * All offsets and sizes are validated before the corresponding
+         * memory is accessed. Each message is decoded independently, so that
+         * a malformed message does not prevent the decoding of the other
+         * ones. The status of each message can be retrieved with
+         * getMessageStatus(). The cell readings and the bottom tracking
+         * values are reset to unknown first, so that the messages missing
+         * from the ensemble do not report the values of the previous one.
+         *
+         * Returns PARSE_OK if the whole ensemble got decoded, and the status
+         * of the first failure otherwise
+         */
+        PARSE_STATUS tryParseEnsemble(uint8_t const* data, size_t size);
+
+        /** Frames and decodes the next ensemble of a buffer that holds a
+         * stream of ensembles, such as a recording
+         *
+         * The search starts at \c offset. Bytes that are not part of a valid
+         * ensemble are skipped.
+         *
+         * On success, \c offset is set to the start of the ensemble, \c
+         * ensemble_size to its size including the checksum, and \c status
+         * to the result of tryParseEnsemble. Returns false if there is no
+         * complete ensemble left in the buffer
+         */
+        bool parseNextEnsemble(uint8_t const* data, size_t size,
+                size_t& offset, size_t& ensemble_size, PARSE_STATUS& status);
+
+        /** Count of messages in the last ensemble passed to tryParseEnsemble
+         */
+        size_t getMessageCount() const;
+        /** Status of the i-th message of the last ensemble passed to
+         * tryParseEnsemble
+         */
+        PARSE_STATUS getMessageStatus(size_t i) const;
+
+        /** True if the last ensemble passed to tryParseEnsemble changed the
+         * device configuration (deviceInfo, acqConf or outputConf)
+         */
+        bool hasConfigurationChanged() const;
+        /** Counter incremented each time the device configuration changes.
+         * It is also reported in Ensemble::configuration_version
+         */
+        uint32_t getConfigurationVersion() const;
+
+        /** Copies the state of the parser, as updated by the last call to
+         * parseEnsemble, into \c ensemble
+         */
+        void exportEnsemble(Ensemble& ensemble) const;
+
+        /** Returns the link health and throughput counters
+         *
+         * This is lock-free, and can be called from any thread
+         */
+        LinkStats getLinkStats() const;
+
+        /** Resets all the link health counters to zero */
+        void resetLinkStats();
     };
 }
 
@@ -71,8 +71,8 @@ namespace dvl_teledyne
             uint8_t  time_between_ping_groups_sec;
             uint8_t  time_between_ping_groups_hundredth;
             uint8_t  coordinate_transformation_mode;
-            uint16_t yaw_alignment;
-            uint16_t yaw_bias;
+            int16_t  yaw_alignment;
+            int16_t  yaw_bias;
             uint8_t  used_sensors;
             uint8_t  available_sensors;
             uint16_t first_cell_distance;
@@ -136,10 +136,10 @@ namespace dvl_teledyne
             uint16_t speed_of_sound;
             uint16_t depth_of_transducer;
             uint16_t yaw;
-            uint16_t pitch;
-            uint16_t roll;
+            int16_t  pitch;
+            int16_t  roll;
             uint16_t salinity_at_transducer;
-            uint16_t temperature_at_transducer;
+            int16_t  temperature_at_transducer;
             uint8_t min_preping_wait_duration_min;
             uint8_t min_preping_wait_duration_sec;
             uint8_t min_preping_wait_duration_hundredth;
@@ -165,56 +165,77 @@ namespace dvl_teledyne
 
 
         /** Format of a velocity for one depth cell
+         *
+         * The per-cell layouts are templated on the count of beams that are
+         * reported in the depth cell messages, i.e. 3 for 3-beam devices and
+         * 4 otherwise (5-beam devices report their vertical beam in separate
+         * messages)
          */
-        struct CellVelocity
+        template<int Beams>
+        struct CellVelocityT
         {
-            uint16_t velocity[4];
+            uint16_t velocity[Beams];
         };
+        typedef CellVelocityT<4> CellVelocity;
 
         /** Variable-size message that contain water velocity w.r.t. the DVL per
          * depth-cell */
-        struct VelocityMessage
+        template<int Beams>
+        struct VelocityMessageT
         {
             enum MSG_ID { ID = 0x0100 };
             int16_t id;
-            CellVelocity velocities[0];
+            CellVelocityT<Beams> velocities[0];
         } __attribute__((packed));
+        typedef VelocityMessageT<4> VelocityMessage;
 
-        struct CellCorrelation
+        template<int Beams>
+        struct CellCorrelationT
         {
-            uint8_t correlation[4];
+            uint8_t correlation[Beams];
         };
+        typedef CellCorrelationT<4> CellCorrelation;
 
-        struct CorrelationMessage
+        template<int Beams>
+        struct CorrelationMessageT
         {
             enum MSG_ID { ID = 0x0200 };
             uint16_t id;
-            CellCorrelation correlations[0];
+            CellCorrelationT<Beams> correlations[0];
         } __attribute__((packed));
+        typedef CorrelationMessageT<4> CorrelationMessage;
 
-        struct CellIntensity
+        template<int Beams>
+        struct CellIntensityT
         {
-            uint8_t intensity[4];
+            uint8_t intensity[Beams];
         };
+        typedef CellIntensityT<4> CellIntensity;
 
-        struct IntensityMessage
+        template<int Beams>
+        struct IntensityMessageT
         {
             enum MSG_ID { ID = 0x0300 };
             uint16_t id;
-            CellIntensity intensities[0];
+            CellIntensityT<Beams> intensities[0];
         } __attribute__((packed));
+        typedef IntensityMessageT<4> IntensityMessage;
 
-        struct CellQuality
+        template<int Beams>
+        struct CellQualityT
         {
-            uint8_t quality[4];
+            uint8_t quality[Beams];
         };
+        typedef CellQualityT<4> CellQuality;
 
-        struct QualityMessage
+        template<int Beams>
+        struct QualityMessageT
         {
             enum MSG_ID { ID = 0x0400 };
             uint16_t id;
-            CellQuality quality[0];
+            CellQualityT<Beams> quality[0];
         } __attribute__((packed));
+        typedef QualityMessageT<4> QualityMessage;
 
         struct BottomTrackingMessage
         {
@@ -231,7 +252,7 @@ namespace dvl_teledyne
             uint32_t reserved;
             uint16_t bottom_range_low[4];
 
-            uint16_t bottom_velocity[4];
+            int16_t  bottom_velocity[4];
             uint8_t  bottom_correlation[4];
             uint8_t  bottom_evaluation[4];
             uint8_t  bottom_good_ping_ratio[4];
@@ -239,7 +260,7 @@ namespace dvl_teledyne
             uint16_t water_layer_min_size;
             uint16_t water_layer_near_boundary;
             uint16_t water_layer_far_boundary;
-            uint16_t water_layer_velocity[4];
+            int16_t  water_layer_velocity[4];
             uint8_t  water_layer_correlation_magnitude[4];
             uint8_t  water_layer_intensity[4];
             uint8_t  water_layer_quality[4];
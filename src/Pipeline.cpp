@@ -0,0 +1,341 @@
+#include <dvl_teledyne/Pipeline.hpp>
+#include <dvl_teledyne/RawStream.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+using namespace dvl_teledyne;
+
+namespace
+{
+    /** Maximum size of a PD0 ensemble, including the checksum */
+    static const size_t MAX_ENSEMBLE_SIZE = 65535 + 2;
+
+    void setAffinity(std::thread& thread, int cpu)
+    {
+        if (cpu < 0)
+            return;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int error = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+        if (error)
+            throw std::runtime_error(std::string("failed to set the thread affinity: ") + strerror(error));
+    }
+}
+
+PipelineConfiguration::PipelineConfiguration()
+    : byte_ring_size(1024 * 1024)
+    , ensemble_queue_size(16)
+    , drop_policy(DROP_OLDEST)
+    , io_cpu(-1)
+    , parser_cpu(-1)
+    , poll_period(base::Time::fromMilliseconds(100))
+{
+}
+
+ByteRing::ByteRing(size_t capacity)
+    : mData(capacity)
+    , mWritten(0)
+    , mRead(0)
+{
+}
+
+size_t ByteRing::write(uint8_t const* data, size_t size)
+{
+    uint64_t written = mWritten.load(std::memory_order_relaxed);
+    uint64_t read    = mRead.load(std::memory_order_acquire);
+    size_t capacity  = mData.size();
+    size = std::min<size_t>(size, capacity - (written - read));
+
+    size_t pos   = written % capacity;
+    size_t first = std::min(size, capacity - pos);
+    memcpy(&mData[pos], data, first);
+    memcpy(&mData[0], data + first, size - first);
+    mWritten.store(written + size, std::memory_order_release);
+    return size;
+}
+
+size_t ByteRing::read(uint8_t* data, size_t size)
+{
+    uint64_t read    = mRead.load(std::memory_order_relaxed);
+    uint64_t written = mWritten.load(std::memory_order_acquire);
+    size_t capacity  = mData.size();
+    size = std::min<size_t>(size, written - read);
+
+    size_t pos   = read % capacity;
+    size_t first = std::min(size, capacity - pos);
+    memcpy(data, &mData[pos], first);
+    memcpy(data + first, &mData[0], size - first);
+    mRead.store(read + size, std::memory_order_release);
+    return size;
+}
+
+void ByteRing::clear()
+{
+    mWritten.store(0);
+    mRead.store(0);
+}
+
+size_t ByteRing::getCapacity() const
+{
+    return mData.size();
+}
+
+size_t ByteRing::getOccupancy() const
+{
+    return mWritten.load(std::memory_order_acquire) - mRead.load(std::memory_order_acquire);
+}
+
+Pipeline::Pipeline(PipelineConfiguration const& conf)
+    : mConf(conf)
+    , mFd(-1)
+    , mRunning(false)
+    , mRecorder(0)
+    , mBytes(conf.byte_ring_size)
+    , mBytesPushed(0)
+    , mBytesDropped(0)
+    , mBytesHighWatermark(0)
+    , mEnsembles(conf.ensemble_queue_size, conf.drop_policy)
+    , mParseErrors(0)
+    , mStreamEnded(false)
+    , mStreamError(0)
+{
+}
+
+Pipeline::~Pipeline()
+{
+    stop();
+}
+
+void Pipeline::start(int fd)
+{
+    if (mRunning)
+        throw std::logic_error("pipeline already running");
+
+    mFd = fd;
+    mBytes.clear();
+    mBytesPushed = 0;
+    mBytesDropped = 0;
+    mBytesHighWatermark = 0;
+    mParseErrors = 0;
+    mStreamEnded = false;
+    mStreamError = 0;
+    mParser.resetLinkStats();
+    mEnsembles.reset();
+
+    mRunning = true;
+    mIOThread = std::thread(&Pipeline::ioLoop, this);
+    mParserThread = std::thread(&Pipeline::parserLoop, this);
+    try
+    {
+        setAffinity(mIOThread, mConf.io_cpu);
+        setAffinity(mParserThread, mConf.parser_cpu);
+    }
+    catch(...)
+    {
+        stop();
+        throw;
+    }
+}
+
+void Pipeline::stop()
+{
+    if (!mRunning)
+        return;
+
+    mRunning = false;
+    mEnsembles.close();
+    {
+        std::lock_guard<std::mutex> lock(mBytesMutex);
+    }
+    mBytesAvailable.notify_all();
+    mIOThread.join();
+    mParserThread.join();
+}
+
+bool Pipeline::isRunning() const
+{
+    return mRunning;
+}
+
+void Pipeline::setRecorder(RawStreamRecorder* recorder)
+{
+    if (mRunning)
+        throw std::logic_error("cannot change the recorder of a running pipeline");
+    mRecorder = recorder;
+}
+
+bool Pipeline::pop(Ensemble& ensemble, base::Time const& timeout)
+{
+    return mEnsembles.pop(ensemble, timeout);
+}
+
+PipelineStatistics Pipeline::getStatistics() const
+{
+    PipelineStatistics stats;
+    stats.bytes.capacity       = mBytes.getCapacity();
+    stats.bytes.occupancy      = mBytes.getOccupancy();
+    stats.bytes.high_watermark = mBytesHighWatermark;
+    stats.bytes.pushed         = mBytesPushed;
+    stats.bytes.dropped        = mBytesDropped;
+    stats.ensembles            = mEnsembles.getStatistics();
+    stats.parse_errors         = mParseErrors;
+    return stats;
+}
+
+LinkStats Pipeline::getLinkStats() const
+{
+    return mParser.getLinkStats();
+}
+
+bool Pipeline::hasStreamEnded() const
+{
+    return mStreamEnded.load(std::memory_order_acquire);
+}
+
+int Pipeline::getStreamError() const
+{
+    return mStreamError;
+}
+
+void Pipeline::endStream(int error)
+{
+    mStreamError = error;
+    mStreamEnded.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(mBytesMutex);
+    }
+    mBytesAvailable.notify_one();
+}
+
+void Pipeline::ioLoop()
+{
+    uint8_t chunk[4096];
+    int timeout_ms = mConf.poll_period.toMilliseconds();
+    while (mRunning)
+    {
+        pollfd pfd;
+        pfd.fd = mFd;
+        pfd.events = POLLIN;
+        int ret = ::poll(&pfd, 1, timeout_ms);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            endStream(errno);
+            return;
+        }
+        else if (ret == 0)
+            continue;
+        else if (pfd.revents & POLLNVAL)
+        {
+            endStream(EBADF);
+            return;
+        }
+
+        // On POLLHUP and POLLERR, read() returns the remaining bytes first,
+        // and then reports the end of the stream or the error
+        ssize_t size = ::read(mFd, chunk, sizeof(chunk));
+        if (size < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                if (pfd.revents & POLLERR)
+                    endStream(EIO);
+                else if (pfd.revents & POLLHUP)
+                    endStream(0);
+                else
+                    continue;
+                return;
+            }
+            endStream(errno);
+            return;
+        }
+        else if (size == 0)
+        {
+            endStream(0);
+            return;
+        }
+        if (mRecorder)
+            mRecorder->record(chunk, size);
+
+        size_t written = mBytes.write(chunk, size);
+        mBytesPushed += written;
+        mBytesDropped += size - written;
+        uint64_t occupancy = mBytes.getOccupancy();
+        if (occupancy > mBytesHighWatermark)
+            mBytesHighWatermark = occupancy;
+
+        {
+            std::lock_guard<std::mutex> lock(mBytesMutex);
+        }
+        mBytesAvailable.notify_one();
+    }
+}
+
+void Pipeline::parserLoop()
+{
+    Ensemble ensemble;
+    std::vector<uint8_t> buffer(2 * MAX_ENSEMBLE_SIZE);
+    size_t start = 0, end = 0;
+    std::chrono::microseconds wait_time(mConf.poll_period.toMicroseconds());
+
+    while (mRunning)
+    {
+        if (start != 0)
+        {
+            memmove(&buffer[0], &buffer[start], end - start);
+            end -= start;
+            start = 0;
+        }
+
+        size_t size = mBytes.read(&buffer[end], buffer.size() - end);
+        if (size == 0)
+        {
+            // The I/O thread writes its last bytes before flagging the end
+            // of the stream, so the ring is complete once the flag is seen
+            if (mStreamEnded.load(std::memory_order_acquire) && mBytes.getOccupancy() == 0)
+            {
+                mEnsembles.close();
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(mBytesMutex);
+            mBytesAvailable.wait_for(lock, wait_time,
+                    [this] { return !mRunning || mStreamEnded || mBytes.getOccupancy() > 0; });
+            continue;
+        }
+        end += size;
+
+        while (start < end)
+        {
+            int packet_size = mParser.extractPacket(&buffer[start], end - start, MAX_ENSEMBLE_SIZE);
+            if (packet_size < 0)
+            {
+                start += -packet_size;
+                continue;
+            }
+            else if (packet_size == 0)
+                break;
+
+            if (mParser.tryParseEnsemble(&buffer[start], packet_size) == PARSE_OK)
+            {
+                mParser.exportEnsemble(ensemble);
+                mEnsembles.push(ensemble);
+            }
+            else
+                mParseErrors++;
+            start += packet_size;
+        }
+    }
+}
+
@@ -0,0 +1,337 @@
+#ifndef DVL_TELEDYNE_PIPELINE_HPP
+#define DVL_TELEDYNE_PIPELINE_HPP
+
+#include <dvl_teledyne/PD0Parser.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dvl_teledyne
+{
+    /** What to do when a stage's output queue is full */
+    enum DROP_POLICIES
+    {
+        /** Replace the oldest element of the queue */
+        DROP_OLDEST,
+        /** Discard the new element */
+        DROP_NEWEST,
+        /** Wait for the consumer to make room */
+        BLOCK
+    };
+
+    struct PipelineConfiguration
+    {
+        /** Size in bytes of the ring between the I/O and the parser threads.
+         * The I/O thread never blocks: bytes that do not fit are discarded
+         */
+        size_t byte_ring_size;
+        /** Count of decoded ensembles that can be queued for the consumers */
+        size_t ensemble_queue_size;
+        /** What the parser thread does when the ensemble queue is full */
+        DROP_POLICIES drop_policy;
+        /** CPU the I/O thread is bound to, or -1 for no affinity */
+        int io_cpu;
+        /** CPU the parser thread is bound to, or -1 for no affinity */
+        int parser_cpu;
+        /** Maximum time the threads wait before checking whether the
+         * pipeline got stopped
+         */
+        base::Time poll_period;
+
+        PipelineConfiguration();
+    };
+
+    /** Occupancy counters of one stage's output queue */
+    struct StageStatistics
+    {
+        /** Capacity of the queue */
+        uint64_t capacity;
+        /** Current count of elements in the queue */
+        uint64_t occupancy;
+        /** Maximum occupancy since the pipeline got started */
+        uint64_t high_watermark;
+        /** Count of elements pushed in the queue */
+        uint64_t pushed;
+        /** Count of elements that got dropped because the queue was full */
+        uint64_t dropped;
+    };
+
+    struct PipelineStatistics
+    {
+        /** Byte ring between the I/O and the parser thread (in bytes) */
+        StageStatistics bytes;
+        /** Queue between the parser thread and the consumers (in
+         * ensembles)
+         */
+        StageStatistics ensembles;
+        /** Count of framed ensembles that failed to decode */
+        uint64_t parse_errors;
+    };
+
+    /** Bounded queue with a configurable drop policy
+     *
+     * Elements are preallocated and exchanged with std::swap, so that
+     * elements that own memory (as Ensemble does) do not get reallocated in
+     * steady state.
+     */
+    template<typename T>
+    class BoundedQueue
+    {
+    public:
+        BoundedQueue(size_t capacity, DROP_POLICIES policy)
+            : mElements(capacity)
+            , mPolicy(policy)
+            , mFirst(0)
+            , mSize(0)
+            , mClosed(false)
+            , mHighWatermark(0)
+            , mPushed(0)
+            , mDropped(0) {}
+
+        /** Pushes \c value in the queue, swapping it with a free element
+         *
+         * Returns false if the element got dropped, or if the queue got
+         * closed while waiting
+         */
+        bool push(T& value)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            if (mSize == mElements.size())
+            {
+                if (mPolicy == DROP_NEWEST)
+                {
+                    mDropped++;
+                    return false;
+                }
+                else if (mPolicy == DROP_OLDEST)
+                {
+                    mFirst = (mFirst + 1) % mElements.size();
+                    mSize--;
+                    mDropped++;
+                }
+                else
+                {
+                    mNotFull.wait(lock, [this] { return mClosed || mSize < mElements.size(); });
+                    if (mClosed)
+                        return false;
+                }
+            }
+
+            std::swap(mElements[(mFirst + mSize) % mElements.size()], value);
+            mSize++;
+            mPushed++;
+            if (mSize > mHighWatermark)
+                mHighWatermark = mSize;
+            lock.unlock();
+            mNotEmpty.notify_one();
+            return true;
+        }
+
+        /** Pops the oldest element into \c value, waiting at most \c timeout
+         *
+         * Returns false on timeout, or if the queue got closed
+         */
+        bool pop(T& value, base::Time const& timeout)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            std::chrono::microseconds wait_time(timeout.toMicroseconds());
+            if (!mNotEmpty.wait_for(lock, wait_time, [this] { return mClosed || mSize > 0; }))
+                return false;
+            if (mSize == 0)
+                return false;
+
+            std::swap(mElements[mFirst], value);
+            mFirst = (mFirst + 1) % mElements.size();
+            mSize--;
+            lock.unlock();
+            mNotFull.notify_one();
+            return true;
+        }
+
+        /** Wakes up all waiting threads and makes push and pop fail */
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mClosed = true;
+            }
+            mNotEmpty.notify_all();
+            mNotFull.notify_all();
+        }
+
+        /** Empties and reopens the queue */
+        void reset()
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mFirst = 0;
+            mSize = 0;
+            mClosed = false;
+            mHighWatermark = 0;
+            mPushed = 0;
+            mDropped = 0;
+        }
+
+        StageStatistics getStatistics() const
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            StageStatistics stats;
+            stats.capacity = mElements.size();
+            stats.occupancy = mSize;
+            stats.high_watermark = mHighWatermark;
+            stats.pushed = mPushed;
+            stats.dropped = mDropped;
+            return stats;
+        }
+
+    private:
+        mutable std::mutex mMutex;
+        std::condition_variable mNotEmpty;
+        std::condition_variable mNotFull;
+        std::vector<T> mElements;
+        DROP_POLICIES mPolicy;
+        size_t mFirst;
+        size_t mSize;
+        bool mClosed;
+        uint64_t mHighWatermark;
+        uint64_t mPushed;
+        uint64_t mDropped;
+    };
+
+    /** Single-producer, single-consumer lock-free byte ring
+     *
+     * Bytes that do not fit are discarded by write(), so that the producer
+     * never waits on the consumer
+     */
+    class ByteRing
+    {
+    public:
+        ByteRing(size_t capacity);
+
+        /** Appends at most \c size bytes. Returns the count of bytes
+         * actually written
+         */
+        size_t write(uint8_t const* data, size_t size);
+        /** Reads at most \c size bytes. Returns the count of bytes actually
+         * read
+         */
+        size_t read(uint8_t* data, size_t size);
+        /** Discards the content of the ring. Must not be called while the
+         * producer or the consumer are active
+         */
+        void clear();
+
+        size_t getCapacity() const;
+        size_t getOccupancy() const;
+
+    private:
+        std::vector<uint8_t> mData;
+        /** Monotonic write and read counters. The positions in mData are the
+         * counters modulo the capacity
+         */
+        std::atomic<uint64_t> mWritten;
+        std::atomic<uint64_t> mRead;
+    };
+
+    class RawStreamRecorder;
+
+    /** Three-stage acquisition pipeline
+     *
+     * An I/O thread drains the file descriptor into a byte ring, a parser
+     * thread extracts and decodes the PD0 ensembles, and the consumers get
+     * the decoded ensembles with pop(). The stages are decoupled by bounded
+     * queues, so that a slow consumer can never make the I/O thread miss
+     * bytes on the serial line.
+     *
+     * The I/O thread stops at the end of the stream (e.g. the writer of a
+     * pipe closed it, or a serial adapter got unplugged) or on a read
+     * error. The ensembles decoded until then can still be popped, after
+     * which pop() returns false immediately. See hasStreamEnded() and
+     * getStreamError().
+     *
+     * The pipeline reads the file descriptor directly. Typically, the
+     * Driver is used to open and configure the device, and the pipeline is
+     * then started on Driver::getFileDescriptor(). The driver must not be
+     * used to read from the device while the pipeline is running.
+     */
+    class Pipeline
+    {
+    public:
+        Pipeline(PipelineConfiguration const& conf = PipelineConfiguration());
+        ~Pipeline();
+
+        /** Starts the pipeline threads on the given file descriptor, which
+         * must be in non-blocking mode
+         */
+        void start(int fd);
+        /** Stops the pipeline threads. Ensembles that are still queued are
+         * discarded
+         */
+        void stop();
+        bool isRunning() const;
+
+        /** Records all the chunks read by the I/O thread, with their arrival
+         * time, to \c recorder. Set to NULL to disable recording
+         *
+         * The recorder is used from the I/O thread. It must not be changed
+         * while the pipeline is running, and must outlive it. Write failures
+         * do not stop the pipeline, see RawStreamRecorder::hasError()
+         */
+        void setRecorder(RawStreamRecorder* recorder);
+
+        /** Gets the oldest decoded ensemble, waiting at most \c timeout
+         *
+         * \c ensemble is swapped with the pipeline's internal storage, so
+         * reusing the same object on each call avoids memory allocations
+         *
+         * Returns false on timeout, or once the stream ended and all the
+         * ensembles decoded before the end got popped
+         */
+        bool pop(Ensemble& ensemble, base::Time const& timeout);
+
+        /** True once the I/O thread stopped reading because the stream ended
+         * or failed. stop() must still be called
+         */
+        bool hasStreamEnded() const;
+        /** The errno value of the failure that ended the stream, or 0 if it
+         * ended normally (end of file or hang-up)
+         */
+        int getStreamError() const;
+
+        PipelineStatistics getStatistics() const;
+
+        /** Returns the link health counters of the parser thread */
+        LinkStats getLinkStats() const;
+
+    private:
+        PipelineConfiguration mConf;
+        int mFd;
+        std::atomic<bool> mRunning;
+        RawStreamRecorder* mRecorder;
+
+        ByteRing mBytes;
+        std::atomic<uint64_t> mBytesPushed;
+        std::atomic<uint64_t> mBytesDropped;
+        std::atomic<uint64_t> mBytesHighWatermark;
+        std::mutex mBytesMutex;
+        std::condition_variable mBytesAvailable;
+
+        PD0Parser mParser;
+        BoundedQueue<Ensemble> mEnsembles;
+        std::atomic<uint64_t> mParseErrors;
+        std::atomic<bool> mStreamEnded;
+        std::atomic<int> mStreamError;
+
+        std::thread mIOThread;
+        std::thread mParserThread;
+
+        void ioLoop();
+        /** Called by the I/O thread when it stops reading */
+        void endStream(int error);
+        void parserLoop();
+    };
+}
+
+#endif
+
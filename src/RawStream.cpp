@@ -0,0 +1,244 @@
+#include <dvl_teledyne/RawStream.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace dvl_teledyne;
+
+namespace
+{
+    static const char RAW_STREAM_MAGIC[8] = { 'D', 'V', 'L', 'R', 'A', 'W', '0', '1' };
+    static const size_t CHUNK_HEADER_SIZE = 6;
+    static const size_t MAX_CHUNK_SIZE = 65535;
+    static const uint32_t MAX_TIME_DELTA = 0xFFFFFFFF;
+
+    void writeChunkHeader(uint8_t* header, uint32_t delta, uint16_t size)
+    {
+        header[0] = delta;
+        header[1] = delta >> 8;
+        header[2] = delta >> 16;
+        header[3] = delta >> 24;
+        header[4] = size;
+        header[5] = size >> 8;
+    }
+
+    std::string errorMessage(std::string const& message, std::string const& path)
+    {
+        return message + " " + path + ": " + strerror(errno);
+    }
+}
+
+RawStreamRecorder::RawStreamRecorder()
+    : mFile(0)
+    , mLastTime(0)
+    , mHasLastTime(false)
+    , mError(0)
+{
+}
+
+RawStreamRecorder::~RawStreamRecorder()
+{
+    close();
+}
+
+void RawStreamRecorder::open(std::string const& path)
+{
+    close();
+    mFile = fopen(path.c_str(), "wb");
+    if (!mFile)
+        throw std::runtime_error(errorMessage("cannot create", path));
+    if (fwrite(RAW_STREAM_MAGIC, sizeof(RAW_STREAM_MAGIC), 1, mFile) != 1)
+    {
+        close();
+        throw std::runtime_error(errorMessage("cannot write to", path));
+    }
+    mHasLastTime = false;
+    mError = 0;
+}
+
+void RawStreamRecorder::close()
+{
+    if (mFile && fclose(mFile) != 0 && !mError)
+        mError = errno;
+    mFile = 0;
+}
+
+bool RawStreamRecorder::isOpen() const
+{
+    return mFile;
+}
+
+bool RawStreamRecorder::hasError() const
+{
+    return mError != 0;
+}
+
+int RawStreamRecorder::getError() const
+{
+    return mError;
+}
+
+void RawStreamRecorder::write(void const* data, size_t size)
+{
+    if (mError || !size)
+        return;
+    if (fwrite(data, size, 1, mFile) != 1)
+        mError = errno ? errno : EIO;
+}
+
+int64_t RawStreamRecorder::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void RawStreamRecorder::record(uint8_t const* data, size_t size)
+{
+    record(now(), data, size);
+}
+
+void RawStreamRecorder::record(int64_t time, uint8_t const* data, size_t size)
+{
+    if (!mFile || mError)
+        return;
+
+    if (!mHasLastTime)
+    {
+        mLastTime = time;
+        mHasLastTime = true;
+    }
+
+    // Gaps longer than the 32 bit delta (~71 minutes) are stored as empty
+    // chunks
+    int64_t delta = std::max<int64_t>(0, time - mLastTime);
+    uint8_t header[CHUNK_HEADER_SIZE];
+    while (delta > MAX_TIME_DELTA)
+    {
+        writeChunkHeader(header, MAX_TIME_DELTA, 0);
+        write(header, CHUNK_HEADER_SIZE);
+        delta -= MAX_TIME_DELTA;
+    }
+    mLastTime = time;
+
+    do
+    {
+        size_t chunk_size = std::min(size, MAX_CHUNK_SIZE);
+        writeChunkHeader(header, delta, chunk_size);
+        write(header, CHUNK_HEADER_SIZE);
+        write(data, chunk_size);
+        data += chunk_size;
+        size -= chunk_size;
+        delta = 0;
+    }
+    while (size > 0);
+}
+
+RawStreamReplayer::RawStreamReplayer()
+    : mFile(0)
+    , mTime(0)
+{
+}
+
+RawStreamReplayer::~RawStreamReplayer()
+{
+    close();
+}
+
+void RawStreamReplayer::open(std::string const& path)
+{
+    close();
+    mFile = fopen(path.c_str(), "rb");
+    if (!mFile)
+        throw std::runtime_error(errorMessage("cannot open", path));
+
+    char magic[sizeof(RAW_STREAM_MAGIC)];
+    if (fread(magic, sizeof(magic), 1, mFile) != 1 ||
+            memcmp(magic, RAW_STREAM_MAGIC, sizeof(magic)))
+    {
+        close();
+        throw std::runtime_error(path + " is not a raw stream recording");
+    }
+    mTime = 0;
+}
+
+void RawStreamReplayer::close()
+{
+    if (mFile)
+        fclose(mFile);
+    mFile = 0;
+}
+
+bool RawStreamReplayer::readChunk(RawChunk& chunk)
+{
+    if (!mFile)
+        return false;
+
+    uint8_t header[CHUNK_HEADER_SIZE];
+    if (fread(header, CHUNK_HEADER_SIZE, 1, mFile) != 1)
+        return false;
+
+    uint32_t delta = static_cast<uint32_t>(header[0]) |
+        static_cast<uint32_t>(header[1]) << 8 |
+        static_cast<uint32_t>(header[2]) << 16 |
+        static_cast<uint32_t>(header[3]) << 24;
+    uint16_t size = header[4] | header[5] << 8;
+
+    mTime += delta;
+    chunk.time = mTime;
+    chunk.data.resize(size);
+    if (size && fread(&chunk.data[0], size, 1, mFile) != 1)
+        return false;
+    return true;
+}
+
+uint64_t RawStreamReplayer::replay(int fd, double speed)
+{
+    uint64_t total = 0;
+    int64_t start = RawStreamRecorder::now();
+    bool has_first = false;
+    int64_t first_time = 0;
+
+    RawChunk chunk;
+    while (readChunk(chunk))
+    {
+        if (!has_first)
+        {
+            first_time = chunk.time;
+            has_first = true;
+        }
+
+        if (speed > 0)
+        {
+            int64_t deadline = start + (chunk.time - first_time) / speed;
+            timespec ts;
+            ts.tv_sec  = deadline / 1000000;
+            ts.tv_nsec = (deadline % 1000000) * 1000;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR);
+        }
+
+        size_t written = 0;
+        while (written < chunk.data.size())
+        {
+            ssize_t ret = ::write(fd, &chunk.data[written], chunk.data.size() - written);
+            if (ret < 0 && errno == EAGAIN)
+            {
+                pollfd pfd;
+                pfd.fd = fd;
+                pfd.events = POLLOUT;
+                ::poll(&pfd, 1, -1);
+                continue;
+            }
+            else if (ret < 0 && errno != EINTR)
+                throw std::runtime_error(std::string("failed to replay: ") + strerror(errno));
+            else if (ret > 0)
+                written += ret;
+        }
+        total += written;
+    }
+    return total;
+}
@@ -0,0 +1,129 @@
+#ifndef DVL_TELEDYNE_RAWSTREAM_HPP
+#define DVL_TELEDYNE_RAWSTREAM_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace dvl_teledyne
+{
+    /** One chunk of bytes, as returned by a single read() on the device */
+    struct RawChunk
+    {
+        /** Time at which the chunk got read, in microseconds since the
+         * beginning of the recording (monotonic clock)
+         */
+        int64_t time;
+        std::vector<uint8_t> data;
+    };
+
+    /** Records the raw byte stream read from the device, chunk by chunk,
+     * with the arrival time of each chunk
+     *
+     * The file starts with an 8-byte magic ("DVLRAW01"). Each chunk is then
+     * stored as a little-endian 32 bit time delta in microseconds since the
+     * previous chunk, a little-endian 16 bit size and the chunk bytes.
+     * Chunks bigger than 65535 bytes are split.
+     *
+     * The timestamps come from the monotonic clock, so that the recording
+     * is not affected by changes of the system time.
+     *
+     * record() does not throw, as it is typically called from the I/O
+     * thread of a Pipeline. The first write failure (e.g. a full disk) is
+     * latched instead, and the chunks that follow it are not recorded. Check
+     * hasError() to know whether the recording is complete.
+     */
+    class RawStreamRecorder
+    {
+    public:
+        RawStreamRecorder();
+        ~RawStreamRecorder();
+
+        /** Creates the recording file, overwriting it if it exists
+         *
+         * Throws std::runtime_error if the file cannot be created
+         */
+        void open(std::string const& path);
+        /** Closes the file. A failure to write the buffered data is latched,
+         * see hasError()
+         */
+        void close();
+        bool isOpen() const;
+
+        /** True if writing to the file failed since open(). The recording
+         * is then truncated at the chunk that could not be written
+         *
+         * It can be called from any thread
+         */
+        bool hasError() const;
+        /** The errno value of the first write failure, or 0 */
+        int getError() const;
+
+        /** Records a chunk that has just been read */
+        void record(uint8_t const* data, size_t size);
+        /** Records a chunk read at the given time of the monotonic clock, in
+         * microseconds
+         */
+        void record(int64_t time, uint8_t const* data, size_t size);
+
+        /** Current time of the monotonic clock, in microseconds */
+        static int64_t now();
+
+    private:
+        FILE* mFile;
+        int64_t mLastTime;
+        bool mHasLastTime;
+        std::atomic<int> mError;
+
+        /** Writes to the file, unless a previous write failed */
+        void write(void const* data, size_t size);
+    };
+
+    /** Plays back recordings made by RawStreamRecorder
+     *
+     * To reproduce the byte arrival pattern seen by the driver, create a
+     * pipe (or a pseudo-terminal), give its read end to the Driver with
+     * setFileDescriptor() or to a Pipeline, and replay() on its write end
+     * from another thread.
+     */
+    class RawStreamReplayer
+    {
+    public:
+        RawStreamReplayer();
+        ~RawStreamReplayer();
+
+        /** Opens a recording
+         *
+         * Throws std::runtime_error if the file cannot be opened or is not a
+         * recording
+         */
+        void open(std::string const& path);
+        void close();
+
+        /** Reads the next chunk of the recording. Returns false at the end of
+         * the file
+         */
+        bool readChunk(RawChunk& chunk);
+
+        /** Writes the remaining chunks on \c fd
+         *
+         * \c speed is the replay speed relative to the recording: 1 replays
+         * at the original rate, 10 ten times faster. Zero writes the chunks
+         * as fast as possible (their boundaries are not preserved then, as
+         * the reader may get several chunks in one read)
+         *
+         * Returns the count of bytes written. Throws std::runtime_error if
+         * writing fails
+         */
+        uint64_t replay(int fd, double speed = 1);
+
+    private:
+        FILE* mFile;
+        int64_t mTime;
+    };
+}
+
+#endif
+
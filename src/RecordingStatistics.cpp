@@ -0,0 +1,306 @@
+#include <dvl_teledyne/RecordingStatistics.hpp>
+#include <base/Float.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <thread>
+
+using namespace dvl_teledyne;
+
+const size_t RecordingStatistics::MAX_REPORTED_GAPS;
+
+namespace
+{
+    /** Correlation bins: 0.05 wide between 0 and 1 */
+    static const size_t CORRELATION_BINS = 20;
+    /** RSSI bins: 5 dB wide up to 115 dB (255 * 0.45) */
+    static const size_t RSSI_BINS = 23;
+    /** Range bins: 0.5 m wide up to 250 m */
+    static const size_t RANGE_BINS = 500;
+
+    /** Analyzes the ensembles that start between \c begin and \c end. They
+     * may extend past \c end
+     */
+    void analyzeRange(uint8_t const* data, size_t size, size_t begin, size_t end,
+            RecordingStatistics& stats, uint64_t& framed_bytes)
+    {
+        PD0Parser parser;
+        size_t offset = begin;
+        size_t ensemble_size;
+        PARSE_STATUS result;
+        framed_bytes = 0;
+        while (offset < end && parser.parseNextEnsemble(data, size, offset, ensemble_size, result))
+        {
+            if (offset >= end)
+                break; // analyzed by the next range
+
+            if (result == PARSE_OK)
+                stats.add(parser, offset);
+            else
+                stats.decode_errors++;
+            framed_bytes += ensemble_size;
+            offset += ensemble_size;
+        }
+    }
+}
+
+Histogram::Histogram()
+    : min(0)
+    , bin_width(1)
+    , underflow(0)
+    , overflow(0)
+{
+}
+
+Histogram::Histogram(float min, float bin_width, size_t bin_count)
+    : min(min)
+    , bin_width(bin_width)
+    , bins(bin_count, 0)
+    , underflow(0)
+    , overflow(0)
+{
+}
+
+void Histogram::add(float value)
+{
+    if (base::isNaN(value))
+        return;
+
+    float bin = (value - min) / bin_width;
+    if (bin < 0)
+        underflow++;
+    else if (bin == bins.size())
+        bins.back()++;
+    else if (bin > bins.size())
+        overflow++;
+    else
+        bins[static_cast<size_t>(bin)]++;
+}
+
+void Histogram::merge(Histogram const& other)
+{
+    if (other.bins.size() != bins.size())
+        throw std::invalid_argument("cannot merge histograms with different bins");
+
+    for (size_t i = 0; i < bins.size(); ++i)
+        bins[i] += other.bins[i];
+    underflow += other.underflow;
+    overflow  += other.overflow;
+}
+
+uint64_t Histogram::count() const
+{
+    uint64_t result = underflow + overflow;
+    for (size_t i = 0; i < bins.size(); ++i)
+        result += bins[i];
+    return result;
+}
+
+float Histogram::quantile(double q) const
+{
+    uint64_t total = count();
+    if (!total)
+        return base::unknown<float>();
+
+    double target = q * total;
+    double cumulated = underflow;
+    if (target <= cumulated)
+        return min;
+    for (size_t i = 0; i < bins.size(); ++i)
+    {
+        if (bins[i] && cumulated + bins[i] >= target)
+            return min + bin_width * (i + (target - cumulated) / bins[i]);
+        cumulated += bins[i];
+    }
+    return min + bin_width * bins.size();
+}
+
+BeamStatistics::BeamStatistics()
+    : bottom_lock(0)
+    , correlation(0, 1.0 / CORRELATION_BINS, CORRELATION_BINS)
+    , rssi(0, 5, RSSI_BINS)
+    , range(0, 0.5, RANGE_BINS)
+{
+}
+
+void BeamStatistics::merge(BeamStatistics const& other)
+{
+    bottom_lock += other.bottom_lock;
+    correlation.merge(other.correlation);
+    rssi.merge(other.rssi);
+    range.merge(other.range);
+}
+
+RecordingStatistics::RecordingStatistics()
+    : ensembles(0)
+    , decode_errors(0)
+    , discarded_bytes(0)
+    , bytes(0)
+    , three_beam_lock(0)
+    , four_beam_lock(0)
+    , sequence_gaps(0)
+    , lost_ensembles(0)
+    , restarts(0)
+    , first_seq(0)
+    , last_seq(0)
+    , first_offset(0)
+{
+}
+
+void RecordingStatistics::addGap(uint64_t offset, uint32_t last, uint32_t next)
+{
+    sequence_gaps++;
+    if (next > last)
+        lost_ensembles += next - last - 1;
+    else
+        restarts++;
+
+    if (gaps.size() < MAX_REPORTED_GAPS)
+    {
+        SequenceGap gap;
+        gap.offset   = offset;
+        gap.last_seq = last;
+        gap.next_seq = next;
+        gaps.push_back(gap);
+    }
+}
+
+void RecordingStatistics::add(PD0Parser const& parser, uint64_t offset)
+{
+    Status const& status = parser.status;
+    if (!ensembles)
+    {
+        first_time   = status.time;
+        first_seq    = status.seq;
+        first_offset = offset;
+    }
+    else if (status.seq != last_seq + 1)
+        addGap(offset, last_seq, status.seq);
+    last_time = status.time;
+    last_seq  = status.seq;
+    ensembles++;
+
+    BottomTracking const& tracking = parser.bottomTracking;
+    int locked_beams = 0;
+    for (int beam = 0; beam < 4; ++beam)
+    {
+        BeamStatistics& beam_stats = beams[beam];
+        if (!base::isNaN(tracking.velocity[beam]))
+        {
+            locked_beams++;
+            beam_stats.bottom_lock++;
+        }
+        beam_stats.correlation.add(tracking.correlation[beam]);
+        beam_stats.rssi.add(tracking.rssi[beam]);
+        beam_stats.range.add(tracking.range[beam]);
+    }
+    if (locked_beams >= 3)
+        three_beam_lock++;
+    if (locked_beams == 4)
+        four_beam_lock++;
+}
+
+void RecordingStatistics::merge(RecordingStatistics const& next)
+{
+    if (ensembles && next.ensembles && next.first_seq != last_seq + 1)
+        addGap(next.first_offset, last_seq, next.first_seq);
+
+    decode_errors   += next.decode_errors;
+    discarded_bytes += next.discarded_bytes;
+    bytes           += next.bytes;
+    three_beam_lock += next.three_beam_lock;
+    four_beam_lock  += next.four_beam_lock;
+    for (int beam = 0; beam < 4; ++beam)
+        beams[beam].merge(next.beams[beam]);
+
+    sequence_gaps  += next.sequence_gaps;
+    lost_ensembles += next.lost_ensembles;
+    restarts       += next.restarts;
+    for (size_t i = 0; i < next.gaps.size() && gaps.size() < MAX_REPORTED_GAPS; ++i)
+        gaps.push_back(next.gaps[i]);
+
+    if (!next.ensembles)
+        return;
+    if (!ensembles)
+    {
+        first_time   = next.first_time;
+        first_seq    = next.first_seq;
+        first_offset = next.first_offset;
+    }
+    last_time = next.last_time;
+    last_seq  = next.last_seq;
+    ensembles += next.ensembles;
+}
+
+RecordingStatistics RecordingStatistics::analyze(uint8_t const* data, size_t size, int thread_count)
+{
+    if (thread_count < 1)
+        thread_count = 1;
+
+    std::vector<RecordingStatistics> partial(thread_count);
+    std::vector<uint64_t> framed_bytes(thread_count);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i)
+    {
+        size_t begin = size * i / thread_count;
+        size_t end   = size * (i + 1) / thread_count;
+        threads.push_back(std::thread(analyzeRange, data, size, begin, end,
+                    std::ref(partial[i]), std::ref(framed_bytes[i])));
+    }
+    for (int i = 0; i < thread_count; ++i)
+        threads[i].join();
+
+    RecordingStatistics result;
+    uint64_t total_framed = 0;
+    for (int i = 0; i < thread_count; ++i)
+    {
+        result.merge(partial[i]);
+        total_framed += framed_bytes[i];
+    }
+    result.bytes = size;
+    result.discarded_bytes = size - total_framed;
+    return result;
+}
+
+RecordingStatistics RecordingStatistics::analyzeFile(std::string const& path, int thread_count)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error("cannot open " + path + ": " + strerror(errno));
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1)
+    {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("cannot stat " + path + ": " + strerror(error));
+    }
+    if (file_stat.st_size == 0)
+    {
+        ::close(fd);
+        return RecordingStatistics();
+    }
+
+    size_t size = file_stat.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED)
+        throw std::runtime_error("cannot map " + path + ": " + strerror(error));
+
+    // Each thread reads its range sequentially
+    madvise(data, size, MADV_WILLNEED);
+    RecordingStatistics result;
+    try { result = analyze(static_cast<uint8_t const*>(data), size, thread_count); }
+    catch(...)
+    {
+        munmap(data, size);
+        throw;
+    }
+    munmap(data, size);
+    return result;
+}
@@ -0,0 +1,136 @@
+#ifndef DVL_TELEDYNE_RECORDINGSTATISTICS_HPP
+#define DVL_TELEDYNE_RECORDINGSTATISTICS_HPP
+
+#include <dvl_teledyne/PD0Parser.hpp>
+#include <string>
+#include <vector>
+
+namespace dvl_teledyne
+{
+    /** Histogram with fixed-width bins. The upper bound of the last bin is
+     * inclusive
+     */
+    struct Histogram
+    {
+        /** Lower bound of the first bin */
+        float min;
+        float bin_width;
+        std::vector<uint64_t> bins;
+        /** Count of values below min and above the last bin */
+        uint64_t underflow;
+        uint64_t overflow;
+
+        Histogram();
+        Histogram(float min, float bin_width, size_t bin_count);
+
+        /** Adds a value. NaN values are ignored */
+        void add(float value);
+        /** Adds the counts of \c other, which must have the same bins */
+        void merge(Histogram const& other);
+        /** Total count of values, including underflow and overflow */
+        uint64_t count() const;
+        /** Approximate quantile (between 0 and 1), interpolated within the
+         * bins. Returns NaN if the histogram is empty
+         */
+        float quantile(double q) const;
+    };
+
+    /** Statistics of one beam over a recording */
+    struct BeamStatistics
+    {
+        /** Count of ensembles with a valid bottom velocity on this beam */
+        uint64_t bottom_lock;
+        /** Bottom correlation, between 0 and 1 */
+        Histogram correlation;
+        /** RSSI at the bottom, in dB */
+        Histogram rssi;
+        /** Range to the bottom, in meters */
+        Histogram range;
+
+        BeamStatistics();
+        void merge(BeamStatistics const& other);
+    };
+
+    /** Discontinuity in the ensemble sequence numbers */
+    struct SequenceGap
+    {
+        /** Offset of the first ensemble after the gap, in bytes from the
+         * beginning of the analyzed data
+         */
+        uint64_t offset;
+        uint32_t last_seq;
+        uint32_t next_seq;
+    };
+
+    /** Statistics of a PD0 recording, computed in parallel
+     *
+     * The recording is split in as many ranges as there are threads. Each
+     * thread decodes the ensembles that start in its range with its own
+     * parser and its own statistics, which are then merged in order.
+     */
+    struct RecordingStatistics
+    {
+        /** Count of ensembles that got decoded */
+        uint64_t ensembles;
+        /** Count of ensembles that passed the framing but failed to decode */
+        uint64_t decode_errors;
+        /** Count of bytes that are not part of any valid ensemble */
+        uint64_t discarded_bytes;
+        /** Total count of bytes analyzed */
+        uint64_t bytes;
+
+        /** Count of ensembles with bottom lock on 3 beams or more, and on all
+         * four beams
+         */
+        uint64_t three_beam_lock;
+        uint64_t four_beam_lock;
+        BeamStatistics beams[4];
+
+        /** Count of discontinuities in the sequence numbers and count of
+         * ensembles that they skip. Sequence numbers that go backwards
+         * (device restart) are counted in restarts instead of lost_ensembles
+         */
+        uint64_t sequence_gaps;
+        uint64_t lost_ensembles;
+        uint64_t restarts;
+        /** The first MAX_REPORTED_GAPS discontinuities */
+        std::vector<SequenceGap> gaps;
+        static const size_t MAX_REPORTED_GAPS = 1000;
+
+        /** First and last ensemble, as time and sequence number */
+        base::Time first_time;
+        base::Time last_time;
+        uint32_t first_seq;
+        uint32_t last_seq;
+        uint64_t first_offset;
+
+        RecordingStatistics();
+
+        /** Adds the ensemble last decoded by \c parser, which started at
+         * \c offset
+         */
+        void add(PD0Parser const& parser, uint64_t offset);
+
+        /** Merges the statistics of the data that follows the data of this
+         * object. Sequence gaps between the two are detected
+         */
+        void merge(RecordingStatistics const& next);
+
+        /** Analyzes a buffer of concatenated PD0 ensembles with \c
+         * thread_count threads
+         */
+        static RecordingStatistics analyze(uint8_t const* data, size_t size, int thread_count);
+
+        /** Maps the file and analyzes it with \c thread_count threads
+         *
+         * Throws std::runtime_error if the file cannot be mapped
+         */
+        static RecordingStatistics analyzeFile(std::string const& path, int thread_count);
+
+    private:
+        void addGap(uint64_t offset, uint32_t last, uint32_t next);
+    };
+}
+
+#endif
+
@@ -0,0 +1,363 @@
+#include <dvl_teledyne/SharedEnsembleRing.hpp>
+#include <dvl_teledyne/PD0Parser.hpp>
+#include <boost/static_assert.hpp>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+using namespace dvl_teledyne;
+
+const int SharedEnsemble::MAX_CELLS;
+const size_t SharedEnsemble::MAX_RAW_SIZE;
+
+// The counters are shared between processes, they must not rely on a lock
+BOOST_STATIC_ASSERT(ATOMIC_LLONG_LOCK_FREE == 2);
+
+namespace dvl_teledyne
+{
+    /** Beginning of the shared memory. It is followed by the slots */
+    struct SharedRingHeader
+    {
+        /** Set to RING_MAGIC once the ring is initialized */
+        std::atomic<uint32_t> magic;
+        /** Size of the header and of a slot, to detect layout differences
+         * between the publisher and the subscribers
+         */
+        uint32_t header_size;
+        uint32_t slot_size;
+        uint32_t slot_count;
+        std::atomic<uint64_t> published;
+        /** Non-zero once the publisher got destroyed */
+        std::atomic<uint32_t> closed;
+    };
+
+    struct SharedRingSlot
+    {
+        /** Odd while the writer updates the slot */
+        std::atomic<uint64_t> seq;
+        /** Publication index of the ensemble in the slot */
+        std::atomic<uint64_t> index;
+        SharedEnsemble ensemble;
+    };
+}
+
+namespace
+{
+    /** "DVLR", marks an initialized ring */
+    static const uint32_t RING_MAGIC = 0x524c5644;
+
+    size_t headerSize()
+    {
+        // Keep the slots on their own cache lines
+        return (sizeof(SharedRingHeader) + 63) / 64 * 64;
+    }
+
+    size_t slotSize()
+    {
+        return (sizeof(SharedRingSlot) + 63) / 64 * 64;
+    }
+
+    SharedRingSlot* slotAt(void* header, size_t i)
+    {
+        return reinterpret_cast<SharedRingSlot*>(
+                static_cast<uint8_t*>(header) + headerSize() + i * slotSize());
+    }
+
+    SharedRingSlot const* slotAt(void const* header, size_t i)
+    {
+        return reinterpret_cast<SharedRingSlot const*>(
+                static_cast<uint8_t const*>(header) + headerSize() + i * slotSize());
+    }
+
+    std::runtime_error systemError(std::string const& what, std::string const& name, int error)
+    {
+        return std::runtime_error(what + " " + name + ": " + strerror(error));
+    }
+}
+
+void SharedEnsemble::toEnsemble(Ensemble& ensemble) const
+{
+    ensemble.configuration_version = configuration_version;
+    ensemble.deviceInfo         = deviceInfo;
+    ensemble.acqConf            = acqConf;
+    ensemble.outputConf         = outputConf;
+    ensemble.status             = status;
+    ensemble.bottomTrackingConf = bottomTrackingConf;
+    ensemble.bottomTracking     = bottomTracking;
+    ensemble.cellReadings.time  = cells_time;
+    // Cap the count, as it may be garbage if the slot is being overwritten
+    size_t count = std::min<size_t>(cell_count, MAX_CELLS);
+    ensemble.cellReadings.readings.resize(count);
+    std::copy(cells, cells + count, ensemble.cellReadings.readings.begin());
+}
+
+SharedEnsemblePublisher::SharedEnsemblePublisher(std::string const& name, size_t slot_count)
+    : mName(name)
+    , mSize(headerSize() + slot_count * slotSize())
+    , mHeader(0)
+{
+    if (slot_count < 2)
+        throw std::invalid_argument("SharedEnsemblePublisher: needs at least two slots");
+
+    // Replace a ring left behind by a publisher that did not terminate
+    // cleanly. Its subscribers keep their mapping, and will never see it
+    // closed
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1)
+        throw systemError("cannot create shared memory", name, errno);
+    if (ftruncate(fd, mSize) == -1)
+    {
+        int error = errno;
+        ::close(fd);
+        shm_unlink(name.c_str());
+        throw systemError("cannot resize shared memory", name, error);
+    }
+    void* data = mmap(NULL, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        throw systemError("cannot map shared memory", name, error);
+    }
+
+    // The memory is zero-filled by ftruncate, which is a valid initial
+    // state for the atomics
+    mHeader = static_cast<SharedRingHeader*>(data);
+    mHeader->header_size = headerSize();
+    mHeader->slot_size   = slotSize();
+    mHeader->slot_count  = slot_count;
+    mHeader->magic.store(RING_MAGIC, std::memory_order_release);
+}
+
+SharedEnsemblePublisher::~SharedEnsemblePublisher()
+{
+    mHeader->closed.store(1, std::memory_order_release);
+    munmap(mHeader, mSize);
+    shm_unlink(mName.c_str());
+}
+
+std::string const& SharedEnsemblePublisher::getName() const
+{
+    return mName;
+}
+
+template<typename Source>
+void SharedEnsemblePublisher::publishImpl(Source const& source, uint32_t configuration_version,
+        base::Time const& time, uint8_t const* raw, size_t raw_size)
+{
+    uint64_t published = mHeader->published.load(std::memory_order_relaxed);
+    SharedRingSlot& slot = *slotAt(mHeader, published % mHeader->slot_count);
+
+    uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.index.store(published, std::memory_order_relaxed);
+    SharedEnsemble& ensemble = slot.ensemble;
+    ensemble.time = time;
+    ensemble.configuration_version = configuration_version;
+    ensemble.deviceInfo         = source.deviceInfo;
+    ensemble.acqConf            = source.acqConf;
+    ensemble.outputConf         = source.outputConf;
+    ensemble.status             = source.status;
+    ensemble.bottomTrackingConf = source.bottomTrackingConf;
+    ensemble.bottomTracking     = source.bottomTracking;
+    ensemble.cells_time         = source.cellReadings.time;
+    ensemble.cell_count = std::min<size_t>(source.cellReadings.readings.size(), SharedEnsemble::MAX_CELLS);
+    std::copy(source.cellReadings.readings.begin(),
+            source.cellReadings.readings.begin() + ensemble.cell_count,
+            ensemble.cells);
+    // A frame that does not fit is not published, rather than truncated
+    ensemble.raw_size = raw_size <= SharedEnsemble::MAX_RAW_SIZE ? raw_size : 0;
+    std::copy(raw, raw + ensemble.raw_size, ensemble.raw);
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+    mHeader->published.store(published + 1, std::memory_order_release);
+}
+
+void SharedEnsemblePublisher::publish(PD0Parser const& parser, base::Time const& time,
+        uint8_t const* raw, size_t raw_size)
+{
+    publishImpl(parser, parser.getConfigurationVersion(), time, raw, raw_size);
+}
+
+void SharedEnsemblePublisher::publish(Ensemble const& ensemble, base::Time const& time,
+        uint8_t const* raw, size_t raw_size)
+{
+    publishImpl(ensemble, ensemble.configuration_version, time, raw, raw_size);
+}
+
+uint64_t SharedEnsemblePublisher::getPublishedCount() const
+{
+    return mHeader->published.load(std::memory_order_acquire);
+}
+
+SharedEnsembleSubscriber::SharedEnsembleSubscriber()
+    : mSize(0)
+    , mHeader(0)
+    , mAcquired(0)
+    , mAcquiredSeq(0)
+    , mNext(0)
+    , mLost(0)
+{
+}
+
+SharedEnsembleSubscriber::~SharedEnsembleSubscriber()
+{
+    close();
+}
+
+void SharedEnsembleSubscriber::open(std::string const& name)
+{
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+        throw systemError("cannot open shared memory", name, errno);
+
+    struct stat shm_stat;
+    if (fstat(fd, &shm_stat) == -1)
+    {
+        int error = errno;
+        ::close(fd);
+        throw systemError("cannot stat shared memory", name, error);
+    }
+    size_t size = shm_stat.st_size;
+    if (size < headerSize())
+    {
+        ::close(fd);
+        throw std::runtime_error("shared memory " + name + " is not initialized");
+    }
+
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED)
+        throw systemError("cannot map shared memory", name, error);
+
+    SharedRingHeader const* header = static_cast<SharedRingHeader const*>(data);
+    if (header->magic.load(std::memory_order_acquire) != RING_MAGIC ||
+            header->header_size != headerSize() || header->slot_size != slotSize() ||
+            size < headerSize() + header->slot_count * slotSize())
+    {
+        munmap(data, size);
+        throw std::runtime_error("shared memory " + name + " is not an ensemble ring, or "
+                "was created by an incompatible version of dvl_teledyne");
+    }
+
+    mSize   = size;
+    mHeader = header;
+    mAcquired = 0;
+    mNext = header->published.load(std::memory_order_acquire);
+    mLost = 0;
+}
+
+void SharedEnsembleSubscriber::close()
+{
+    if (!mHeader)
+        return;
+    munmap(const_cast<SharedRingHeader*>(mHeader), mSize);
+    mHeader = 0;
+    mAcquired = 0;
+}
+
+bool SharedEnsembleSubscriber::isOpen() const
+{
+    return mHeader;
+}
+
+bool SharedEnsembleSubscriber::isPublisherClosed() const
+{
+    return mHeader->closed.load(std::memory_order_acquire);
+}
+
+size_t SharedEnsembleSubscriber::getSlotCount() const
+{
+    return mHeader->slot_count;
+}
+
+uint64_t SharedEnsembleSubscriber::getPublishedCount() const
+{
+    return mHeader->published.load(std::memory_order_acquire);
+}
+
+SharedEnsemble const* SharedEnsembleSubscriber::acquire(uint64_t index)
+{
+    mAcquired = 0;
+    SharedRingSlot const* slot = slotAt(mHeader, index % mHeader->slot_count);
+    uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    if ((seq & 1) || slot->index.load(std::memory_order_relaxed) != index)
+        return 0;
+
+    mAcquired = slot;
+    mAcquiredSeq = seq;
+    return &slot->ensemble;
+}
+
+SharedEnsemble const* SharedEnsembleSubscriber::acquireLatest()
+{
+    while (true)
+    {
+        uint64_t published = getPublishedCount();
+        if (published == 0)
+            return 0;
+        // Fails only if the writer wrapped around the whole ring since we
+        // read the published count
+        if (SharedEnsemble const* ensemble = acquire(published - 1))
+            return ensemble;
+    }
+}
+
+SharedEnsemble const* SharedEnsembleSubscriber::acquireNext()
+{
+    uint64_t published = getPublishedCount();
+    if (mNext + mHeader->slot_count < published)
+    {
+        mLost += published - mHeader->slot_count - mNext;
+        mNext = published - mHeader->slot_count;
+    }
+
+    while (mNext < published)
+    {
+        SharedEnsemble const* ensemble = acquire(mNext++);
+        if (ensemble)
+            return ensemble;
+        mLost++;
+    }
+    mAcquired = 0;
+    return 0;
+}
+
+bool SharedEnsembleSubscriber::validate() const
+{
+    if (!mAcquired)
+        return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return mAcquired->seq.load(std::memory_order_relaxed) == mAcquiredSeq;
+}
+
+bool SharedEnsembleSubscriber::read(Ensemble& ensemble)
+{
+    while (true)
+    {
+        SharedEnsemble const* shared = acquireLatest();
+        if (!shared)
+            return false;
+        shared->toEnsemble(ensemble);
+        if (validate())
+            return true;
+    }
+}
+
+uint64_t SharedEnsembleSubscriber::getLostCount() const
+{
+    return mLost;
+}
@@ -0,0 +1,209 @@
+#ifndef DVL_TELEDYNE_SHAREDENSEMBLERING_HPP
+#define DVL_TELEDYNE_SHAREDENSEMBLERING_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+#include <string>
+
+namespace dvl_teledyne
+{
+    class PD0Parser;
+    /** Layout of the shared memory, see SharedEnsembleRing.cpp */
+    struct SharedRingHeader;
+    struct SharedRingSlot;
+
+    /** One ensemble, as stored in the shared memory ring
+     *
+     * The raw frame is stored last, so that readers that only need the
+     * decoded data do not touch its pages.
+     */
+    struct SharedEnsemble
+    {
+        /** Maximum count of depth cells in an ensemble */
+        static const int MAX_CELLS = 255;
+        /** Maximum size of a raw frame. A PD0 ensemble is at most 65535
+         * bytes, plus the checksum
+         */
+        static const size_t MAX_RAW_SIZE = 65537;
+
+        /** Reception time of the ensemble on the host */
+        base::Time time;
+
+        uint32_t configuration_version;
+        DeviceInfo deviceInfo;
+        AcquisitionConfiguration acqConf;
+        OutputConfiguration outputConf;
+        Status status;
+        BottomTrackingConfiguration bottomTrackingConf;
+        BottomTracking bottomTracking;
+        base::Time cells_time;
+        uint32_t cell_count;
+        CellReading cells[MAX_CELLS];
+
+        /** Size of the raw frame. Zero if it is not available, as for PD6
+         * ensembles which are made of several lines
+         */
+        uint32_t raw_size;
+        uint8_t raw[MAX_RAW_SIZE];
+
+        /** Copies the decoded data into \c ensemble */
+        void toEnsemble(Ensemble& ensemble) const;
+    };
+
+    /** Publication of the decoded ensembles, and of their raw frame, in a
+     * POSIX shared memory ring
+     *
+     * This lets several processes on the same host (navigation, logging,
+     * GUI bridges, ...) get the data of a single driver. The ring follows
+     * the same protocol as SnapshotBuffer: each slot is protected by a
+     * sequence lock, the single writer never waits and the readers check
+     * after the fact that the slot did not get overwritten while they were
+     * reading it. See SharedEnsembleSubscriber for the reader side.
+     *
+     * The shared memory object is created by the constructor, replacing any
+     * stale object of the same name, and removed by the destructor. Readers
+     * that still have it mapped see it as closed, and can reopen it to
+     * follow a new publisher.
+     */
+    class SharedEnsemblePublisher
+    {
+    public:
+        /** Creates the ring
+         *
+         * @param name the shared memory object name, as for shm_open (e.g.
+         *   "/dvl_teledyne")
+         * @param slot_count count of ensembles the ring can hold. Readers
+         *   that fall behind by more than this lose ensembles
+         *
+         * Throws std::runtime_error if the shared memory cannot be created
+         */
+        SharedEnsemblePublisher(std::string const& name, size_t slot_count = 16);
+        ~SharedEnsemblePublisher();
+
+        std::string const& getName() const;
+
+        /** Publishes the ensemble that has just been decoded by \c parser,
+         * along with its raw frame. Only one thread may publish
+         */
+        void publish(PD0Parser const& parser, base::Time const& time,
+                uint8_t const* raw, size_t raw_size);
+        /** Publishes \c ensemble, along with its raw frame. Only one thread
+         * may publish
+         */
+        void publish(Ensemble const& ensemble, base::Time const& time,
+                uint8_t const* raw, size_t raw_size);
+
+        /** Count of ensembles published so far */
+        uint64_t getPublishedCount() const;
+
+    private:
+        std::string mName;
+        size_t mSize;
+        SharedRingHeader* mHeader;
+
+        SharedEnsemblePublisher(SharedEnsemblePublisher const&);
+        SharedEnsemblePublisher& operator =(SharedEnsemblePublisher const&);
+
+        template<typename Source>
+        void publishImpl(Source const& source, uint32_t configuration_version,
+                base::Time const& time, uint8_t const* raw, size_t raw_size);
+    };
+
+    /** Reader side of SharedEnsemblePublisher
+     *
+     * The ring is mapped read-only and the ensembles are accessed in place:
+     * there is no copy and no system call per ensemble. Since the publisher
+     * may overwrite a slot at any time, the pointer returned by the acquire
+     * methods is only valid until the next acquire, and whatever has been
+     * read through it must be discarded if validate() returns false:
+     *
+     * <code>
+     * while (SharedEnsemble const* ensemble = subscriber.acquireNext())
+     * {
+     *     float range = ensemble->bottomTracking.range[0];
+     *     if (subscriber.validate())
+     *         use(range);
+     * }
+     * </code>
+     *
+     * There is no notification mechanism. Readers poll getPublishedCount()
+     * or acquireNext() at the rate they need.
+     */
+    class SharedEnsembleSubscriber
+    {
+    public:
+        SharedEnsembleSubscriber();
+        ~SharedEnsembleSubscriber();
+
+        /** Maps the ring created by the publisher with the given name
+         *
+         * Only the ensembles published after this call are returned by
+         * acquireNext(). Throws std::runtime_error if the ring does not
+         * exist or was created by an incompatible version of this library
+         */
+        void open(std::string const& name);
+        void close();
+        bool isOpen() const;
+
+        /** True if the publisher got destroyed. No new ensemble will be
+         * published in the ring, open() it again to follow a new publisher
+         */
+        bool isPublisherClosed() const;
+
+        size_t getSlotCount() const;
+        /** Count of ensembles published so far in the ring */
+        uint64_t getPublishedCount() const;
+
+        /** Starts reading the ensemble with the given publication index,
+         * which starts at zero
+         *
+         * Returns NULL if this ensemble is not published yet, or if it
+         * already got overwritten
+         */
+        SharedEnsemble const* acquire(uint64_t index);
+        /** Starts reading the last published ensemble. Returns NULL if no
+         * ensemble has been published yet
+         */
+        SharedEnsemble const* acquireLatest();
+        /** Starts reading the ensemble that follows the one previously
+         * returned by acquireNext(). Returns NULL if there is no new
+         * ensemble
+         *
+         * Ensembles that got overwritten before the reader could get to
+         * them are skipped and counted in getLostCount()
+         */
+        SharedEnsemble const* acquireNext();
+
+        /** True if the ensemble returned by the last acquire did not get
+         * overwritten since then, i.e. if the data read from it is
+         * consistent
+         */
+        bool validate() const;
+
+        /** Copies the last published ensemble into \c ensemble, retrying
+         * until the copy is consistent
+         *
+         * As SnapshotBuffer::read, it resizes the cell readings only if the
+         * count of cells changed. Returns false if no ensemble has been
+         * published yet
+         */
+        bool read(Ensemble& ensemble);
+
+        /** Count of ensembles skipped by acquireNext() */
+        uint64_t getLostCount() const;
+
+    private:
+        size_t mSize;
+        SharedRingHeader const* mHeader;
+        /** Slot and sequence number of the last acquire */
+        SharedRingSlot const* mAcquired;
+        uint64_t mAcquiredSeq;
+        uint64_t mNext;
+        uint64_t mLost;
+
+        SharedEnsembleSubscriber(SharedEnsembleSubscriber const&);
+        SharedEnsembleSubscriber& operator =(SharedEnsembleSubscriber const&);
+    };
+}
+
+#endif
+
@@ -0,0 +1,92 @@
+#include <dvl_teledyne/SnapshotBuffer.hpp>
+#include <dvl_teledyne/PD0Parser.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace dvl_teledyne;
+
+SnapshotBuffer::SnapshotBuffer(size_t slot_count)
+    : mSlotCount(slot_count)
+    , mPublished(0)
+{
+    if (slot_count < 2)
+        throw std::invalid_argument("SnapshotBuffer: needs at least two slots");
+    mSlots.reset(new Slot[slot_count]);
+}
+
+template<typename Source>
+void SnapshotBuffer::publishImpl(Source const& source, uint32_t configuration_version)
+{
+    uint64_t published = mPublished.load(std::memory_order_relaxed);
+    Slot& slot = mSlots[published % mSlotCount];
+
+    uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.configuration_version = configuration_version;
+    slot.deviceInfo         = source.deviceInfo;
+    slot.acqConf            = source.acqConf;
+    slot.outputConf         = source.outputConf;
+    slot.status             = source.status;
+    slot.bottomTrackingConf = source.bottomTrackingConf;
+    slot.bottomTracking     = source.bottomTracking;
+    slot.cells_time         = source.cellReadings.time;
+    slot.cell_count = std::min<size_t>(source.cellReadings.readings.size(), MAX_CELLS);
+    std::copy(source.cellReadings.readings.begin(),
+            source.cellReadings.readings.begin() + slot.cell_count,
+            slot.cells);
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+    mPublished.store(published + 1, std::memory_order_release);
+}
+
+void SnapshotBuffer::publish(PD0Parser const& parser)
+{
+    publishImpl(parser, parser.getConfigurationVersion());
+}
+
+void SnapshotBuffer::publish(Ensemble const& ensemble)
+{
+    publishImpl(ensemble, ensemble.configuration_version);
+}
+
+bool SnapshotBuffer::read(Ensemble& ensemble) const
+{
+    while (true)
+    {
+        uint64_t published = mPublished.load(std::memory_order_acquire);
+        if (published == 0)
+            return false;
+
+        Slot const& slot = mSlots[(published - 1) % mSlotCount];
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq & 1)
+            continue;
+
+        ensemble.configuration_version = slot.configuration_version;
+        ensemble.deviceInfo         = slot.deviceInfo;
+        ensemble.acqConf            = slot.acqConf;
+        ensemble.outputConf         = slot.outputConf;
+        ensemble.status             = slot.status;
+        ensemble.bottomTrackingConf = slot.bottomTrackingConf;
+        ensemble.bottomTracking     = slot.bottomTracking;
+        ensemble.cellReadings.time  = slot.cells_time;
+        // Cap the count, as it may be garbage if the slot is being
+        // overwritten. The copy is discarded below in this case
+        size_t cell_count = std::min(std::max(slot.cell_count, 0), static_cast<int>(MAX_CELLS));
+        ensemble.cellReadings.readings.resize(cell_count);
+        std::copy(slot.cells, slot.cells + cell_count,
+                ensemble.cellReadings.readings.begin());
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == seq)
+            return true;
+    }
+}
+
+uint64_t SnapshotBuffer::getPublishedCount() const
+{
+    return mPublished.load(std::memory_order_acquire);
+}
+
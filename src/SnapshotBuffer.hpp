@@ -0,0 +1,89 @@
+#ifndef DVL_TELEDYNE_SNAPSHOTBUFFER_HPP
+#define DVL_TELEDYNE_SNAPSHOTBUFFER_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+#include <atomic>
+#include <memory>
+
+namespace dvl_teledyne
+{
+    class PD0Parser;
+
+    /** Lock-free publication of complete ensembles
+     *
+     * The parser state is overwritten field by field while an ensemble gets
+     * decoded, so other threads reading it directly may see a mix of two
+     * ensembles. This class publishes each complete ensemble in a ring of
+     * slots, each of them protected by a sequence lock:
+     *
+     * <ul>
+     * <li>the single writer never waits on the readers. It bumps the slot's
+     *     sequence number to an odd value, copies the ensemble and bumps the
+     *     sequence number again
+     * <li>readers copy the most recent slot and retry if its sequence number
+     *     changed during the copy, i.e. if the writer wrapped around the
+     *     whole ring while they were reading
+     * </ul>
+     */
+    class SnapshotBuffer
+    {
+    public:
+        /** Maximum count of depth cells in an ensemble */
+        static const int MAX_CELLS = 255;
+
+        /** Creates the buffer with the given count of slots. More slots make
+         * it less likely that a slow reader has to retry
+         */
+        SnapshotBuffer(size_t slot_count = 4);
+
+        /** Publishes the ensemble that has just been decoded by \c parser.
+         * Only one thread may publish
+         */
+        void publish(PD0Parser const& parser);
+        /** Publishes \c ensemble. Only one thread may publish */
+        void publish(Ensemble const& ensemble);
+
+        /** Copies the last published ensemble into \c ensemble
+         *
+         * The cell readings vector of \c ensemble is resized only if the
+         * count of cells changed, so reusing the same object avoids memory
+         * allocations. Returns false if no ensemble has been published yet
+         */
+        bool read(Ensemble& ensemble) const;
+
+        /** Count of ensembles published so far. Readers can use it to check
+         * whether a new ensemble is available
+         */
+        uint64_t getPublishedCount() const;
+
+    private:
+        struct Slot
+        {
+            /** Odd while the writer updates the slot */
+            std::atomic<uint64_t> seq;
+
+            uint32_t configuration_version;
+            DeviceInfo deviceInfo;
+            AcquisitionConfiguration acqConf;
+            OutputConfiguration outputConf;
+            Status status;
+            BottomTrackingConfiguration bottomTrackingConf;
+            BottomTracking bottomTracking;
+            base::Time cells_time;
+            int cell_count;
+            CellReading cells[MAX_CELLS];
+
+            Slot() : seq(0) {}
+        };
+
+        size_t mSlotCount;
+        std::unique_ptr<Slot[]> mSlots;
+        std::atomic<uint64_t> mPublished;
+
+        template<typename Source>
+        void publishImpl(Source const& source, uint32_t configuration_version);
+    };
+}
+
+#endif
+
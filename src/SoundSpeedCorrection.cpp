@@ -0,0 +1,115 @@
+#include <dvl_teledyne/SoundSpeedCorrection.hpp>
+#include <base/Float.hpp>
+#include <stdexcept>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace dvl_teledyne;
+
+namespace
+{
+#ifdef __SSE2__
+    typedef __m128 Ratio;
+
+    Ratio makeRatio(float ratio)
+    {
+        return _mm_set1_ps(ratio);
+    }
+
+    void scale(float* values, Ratio ratio)
+    {
+        _mm_storeu_ps(values, _mm_mul_ps(_mm_loadu_ps(values), ratio));
+    }
+#else
+    typedef float Ratio;
+
+    Ratio makeRatio(float ratio)
+    {
+        return ratio;
+    }
+
+    void scale(float* values, Ratio ratio)
+    {
+        for (int i = 0; i < 4; ++i)
+            values[i] *= ratio;
+    }
+#endif
+
+    void scaleVelocities(Ensemble& ensemble, Ratio ratio)
+    {
+        std::vector<CellReading>& cells = ensemble.cellReadings.readings;
+        for (size_t i = 0; i < cells.size(); ++i)
+            scale(cells[i].velocity, ratio);
+
+        BottomTracking& tracking = ensemble.bottomTracking;
+        scale(tracking.range, ratio);
+        scale(tracking.velocity, ratio);
+        scale(tracking.water_layer_velocity, ratio);
+    }
+}
+
+SoundSpeedCorrection::SoundSpeedCorrection()
+    : mSoundSpeed(base::unknown<float>())
+{
+}
+
+SoundSpeedCorrection::SoundSpeedCorrection(float speed_of_sound)
+{
+    setSoundSpeed(speed_of_sound);
+}
+
+void SoundSpeedCorrection::setSoundSpeed(float speed_of_sound)
+{
+    if (!(speed_of_sound > 0))
+        throw std::invalid_argument("SoundSpeedCorrection: the speed of sound must be strictly positive");
+    mSoundSpeed = speed_of_sound;
+}
+
+void SoundSpeedCorrection::setWaterProperties(float temperature, float salinity, float depth)
+{
+    setSoundSpeed(mackenzie(temperature, salinity, depth));
+}
+
+float SoundSpeedCorrection::getSoundSpeed() const
+{
+    return mSoundSpeed;
+}
+
+bool SoundSpeedCorrection::apply(Ensemble& ensemble) const
+{
+    float device_speed = ensemble.status.speed_of_sound;
+    if (base::isUnknown(mSoundSpeed) || !(device_speed > 0))
+        return false;
+    if (device_speed == mSoundSpeed)
+        return true;
+
+    float ratio = mSoundSpeed / device_speed;
+    scaleVelocities(ensemble, makeRatio(ratio));
+
+    // The depth cells and the water layer are defined by times of flight
+    AcquisitionConfiguration& acq = ensemble.acqConf;
+    acq.cell_length                   *= ratio;
+    acq.first_cell_distance           *= ratio;
+    acq.blank_after_transmit_distance *= ratio;
+    acq.transmit_pulse_length         *= ratio;
+
+    BottomTrackingConfiguration& tracking = ensemble.bottomTrackingConf;
+    tracking.max_tracking_depth        *= ratio;
+    tracking.water_layer_min_size      *= ratio;
+    tracking.water_layer_near_boundary *= ratio;
+    tracking.water_layer_far_boundary  *= ratio;
+
+    ensemble.status.speed_of_sound = mSoundSpeed;
+    return true;
+}
+
+float SoundSpeedCorrection::mackenzie(float temperature, float salinity, float depth)
+{
+    double t = temperature;
+    double s = salinity * 1000 - 35;
+    double d = depth;
+    return 1448.96 + 4.591 * t - 5.304e-2 * t * t + 2.374e-4 * t * t * t
+        + 1.340 * s + 1.630e-2 * d + 1.675e-7 * d * d
+        - 1.025e-2 * t * s - 7.139e-13 * t * d * d * d;
+}
@@ -0,0 +1,62 @@
+#ifndef DVL_TELEDYNE_SOUNDSPEEDCORRECTION_HPP
+#define DVL_TELEDYNE_SOUNDSPEEDCORRECTION_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+
+namespace dvl_teledyne
+{
+    /** Correction of an ensemble for the speed of sound
+     *
+     * The device converts Doppler shifts and times of flight using its own
+     * speed of sound (Status::speed_of_sound), which is often computed from
+     * an assumed salinity. Velocities, ranges and distances all scale with
+     * the ratio between the actual speed of sound and the one used by the
+     * device, so a better value (e.g. from a CTD) can be applied after the
+     * fact, on live data as well as when reprocessing recordings.
+     *
+     * apply() rescales the cell and bottom tracking velocities, the bottom
+     * ranges and the cell and water layer geometry, and updates
+     * Status::speed_of_sound accordingly, so that applying the same
+     * correction twice is harmless. The cell velocities are processed with
+     * SSE, one cell per instruction.
+     */
+    class SoundSpeedCorrection
+    {
+    public:
+        /** Creates a correction with an unknown speed of sound. apply()
+         * does nothing until it is set
+         */
+        SoundSpeedCorrection();
+        SoundSpeedCorrection(float speed_of_sound);
+
+        /** Sets the actual speed of sound, in m/s */
+        void setSoundSpeed(float speed_of_sound);
+        /** Sets the actual speed of sound from the water properties, see
+         * mackenzie()
+         */
+        void setWaterProperties(float temperature, float salinity, float depth);
+        float getSoundSpeed() const;
+
+        /** Corrects \c ensemble for the actual speed of sound
+         *
+         * Returns false, and leaves the ensemble unchanged, if either the
+         * actual speed of sound or the one used by the device is unknown
+         */
+        bool apply(Ensemble& ensemble) const;
+
+        /** Speed of sound in m/s according to the Mackenzie (1981) equation
+         *
+         * @param temperature in degrees Celsius, valid from -2 to 30
+         * @param salinity as in Status, i.e. as a ratio (0.035 for 35 ppt),
+         *   valid from 25 to 40 ppt
+         * @param depth in meters, valid down to 8000m
+         */
+        static float mackenzie(float temperature, float salinity, float depth);
+
+    private:
+        float mSoundSpeed;
+    };
+}
+
+#endif
+
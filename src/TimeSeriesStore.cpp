@@ -0,0 +1,259 @@
+#include <dvl_teledyne/TimeSeriesStore.hpp>
+#include <base/Float.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace dvl_teledyne;
+
+TimeSeriesConfiguration::TimeSeriesConfiguration()
+    : level_count(6)
+    , level_capacity(4096)
+    , decimation(8)
+{
+}
+
+TimeSeriesStore::TimeSeriesStore(TimeSeriesConfiguration const& conf)
+    : mConf(conf)
+{
+    if (conf.level_count < 1 || conf.level_capacity < 1 || conf.decimation < 2)
+        throw std::invalid_argument("TimeSeriesStore: invalid configuration");
+
+    mLevels.resize(conf.level_count);
+    for (int i = 0; i < conf.level_count; ++i)
+        mLevels[i].buckets.resize(conf.level_capacity);
+    clear();
+}
+
+TimeSeriesConfiguration const& TimeSeriesStore::getConfiguration() const
+{
+    return mConf;
+}
+
+void TimeSeriesStore::clear()
+{
+    for (size_t i = 0; i < mLevels.size(); ++i)
+    {
+        mLevels[i].first = 0;
+        mLevels[i].size = 0;
+        mLevels[i].wrapped = false;
+        resetPending(mLevels[i]);
+    }
+}
+
+void TimeSeriesStore::resetPending(Level& level)
+{
+    TimeSeriesBucket& pending = level.pending;
+    pending.count = 0;
+    for (int c = 0; c < CHANNEL_COUNT; ++c)
+    {
+        pending.valid[c] = 0;
+        pending.min[c] = base::unknown<float>();
+        pending.max[c] = base::unknown<float>();
+        pending.mean[c] = base::unknown<float>();
+        level.pending_sum[c] = 0;
+    }
+    level.pending_children = 0;
+}
+
+void TimeSeriesStore::push(base::Time const& time, float const* values)
+{
+    TimeSeriesBucket sample;
+    sample.start = time;
+    sample.end   = time;
+    sample.count = 1;
+    for (int c = 0; c < CHANNEL_COUNT; ++c)
+    {
+        bool known = !base::isNaN(values[c]);
+        sample.valid[c] = known ? 1 : 0;
+        sample.min[c]   = values[c];
+        sample.max[c]   = values[c];
+        sample.mean[c]  = values[c];
+    }
+    append(0, sample);
+}
+
+void TimeSeriesStore::push(BottomTracking const& tracking, Status const& status)
+{
+    float values[CHANNEL_COUNT];
+
+    float range_sum = 0, correlation_sum = 0;
+    int range_count = 0, correlation_count = 0;
+    for (int beam = 0; beam < 4; ++beam)
+    {
+        if (!base::isNaN(tracking.range[beam]))
+        {
+            range_sum += tracking.range[beam];
+            range_count++;
+        }
+        if (!base::isNaN(tracking.correlation[beam]))
+        {
+            correlation_sum += tracking.correlation[beam];
+            correlation_count++;
+        }
+    }
+    values[CHANNEL_RANGE] = range_count ? range_sum / range_count : base::unknown<float>();
+    values[CHANNEL_VELOCITY_X] = tracking.velocity[0];
+    values[CHANNEL_VELOCITY_Y] = tracking.velocity[1];
+    values[CHANNEL_VELOCITY_Z] = tracking.velocity[2];
+    values[CHANNEL_CORRELATION] = correlation_count ? correlation_sum / correlation_count : base::unknown<float>();
+    values[CHANNEL_TEMPERATURE] = status.temperature;
+    values[CHANNEL_DEPTH] = status.depth;
+    push(status.time, values);
+}
+
+void TimeSeriesStore::append(int level_idx, TimeSeriesBucket const& bucket)
+{
+    Level& level = mLevels[level_idx];
+    size_t capacity = level.buckets.size();
+    if (level.size == capacity)
+    {
+        level.buckets[level.first] = bucket;
+        level.first = (level.first + 1) % capacity;
+        level.wrapped = true;
+    }
+    else
+    {
+        level.buckets[(level.first + level.size) % capacity] = bucket;
+        level.size++;
+    }
+
+    if (level_idx + 1 < static_cast<int>(mLevels.size()))
+        aggregate(level_idx + 1, bucket);
+}
+
+void TimeSeriesStore::aggregate(int level_idx, TimeSeriesBucket const& bucket)
+{
+    Level& level = mLevels[level_idx];
+    TimeSeriesBucket& pending = level.pending;
+    if (pending.count == 0 && level.pending_children == 0)
+        pending.start = bucket.start;
+    pending.end = bucket.end;
+    pending.count += bucket.count;
+    for (int c = 0; c < CHANNEL_COUNT; ++c)
+    {
+        if (!bucket.valid[c])
+            continue;
+
+        if (!pending.valid[c])
+        {
+            pending.min[c] = bucket.min[c];
+            pending.max[c] = bucket.max[c];
+        }
+        else
+        {
+            pending.min[c] = std::min(pending.min[c], bucket.min[c]);
+            pending.max[c] = std::max(pending.max[c], bucket.max[c]);
+        }
+        pending.valid[c] += bucket.valid[c];
+        level.pending_sum[c] += static_cast<double>(bucket.mean[c]) * bucket.valid[c];
+    }
+
+    if (++level.pending_children < mConf.decimation)
+        return;
+
+    TimeSeriesBucket complete = pendingBucket(level);
+    resetPending(level);
+    append(level_idx, complete);
+}
+
+TimeSeriesBucket TimeSeriesStore::pendingBucket(Level const& level)
+{
+    TimeSeriesBucket bucket = level.pending;
+    for (int c = 0; c < CHANNEL_COUNT; ++c)
+    {
+        if (bucket.valid[c])
+            bucket.mean[c] = level.pending_sum[c] / bucket.valid[c];
+    }
+    return bucket;
+}
+
+TimeSeriesBucket const& TimeSeriesStore::at(Level const& level, size_t i) const
+{
+    return level.buckets[(level.first + i) % level.buckets.size()];
+}
+
+size_t TimeSeriesStore::lowerBound(Level const& level, base::Time const& time) const
+{
+    size_t low = 0, high = level.size;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (at(level, middle).end < time)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+size_t TimeSeriesStore::countInRange(Level const& level, base::Time const& start, base::Time const& end) const
+{
+    size_t first = lowerBound(level, start);
+    // Buckets are sorted by start time as well, so we can binary search for
+    // the last bucket that starts before the end of the range
+    size_t low = first, high = level.size;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (end < at(level, middle).start)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return low - first;
+}
+
+base::Time TimeSeriesStore::getOldestTime(int level) const
+{
+    Level const& l = mLevels.at(level);
+    if (l.size == 0)
+        return base::Time();
+    return at(l, 0).start;
+}
+
+int TimeSeriesStore::query(base::Time const& start, base::Time const& end,
+        std::vector<TimeSeriesBucket>& result, size_t max_points) const
+{
+    result.clear();
+
+    int level_count = mLevels.size();
+    int level_idx = 0;
+    for (; level_idx < level_count - 1; ++level_idx)
+    {
+        Level const& level = mLevels[level_idx];
+        // Skip levels whose history does not go back to the start of the
+        // range ...
+        if (level.wrapped && start < at(level, 0).start)
+            continue;
+        // ... or that would return too many points
+        if (max_points && countInRange(level, start, end) > max_points)
+            continue;
+        break;
+    }
+
+    Level const& level = mLevels[level_idx];
+    for (size_t i = lowerBound(level, start); i < level.size; ++i)
+    {
+        TimeSeriesBucket const& bucket = at(level, i);
+        if (end < bucket.start)
+            return level_idx;
+        result.push_back(bucket);
+    }
+
+    // The samples received since the last complete bucket of the level are
+    // still being aggregated in the pending buckets of this level and of the
+    // finer ones. The finer the level, the more recent its pending bucket
+    for (int i = level_idx; i > 0; --i)
+    {
+        Level const& finer = mLevels[i];
+        if (!finer.pending_children)
+            continue;
+        TimeSeriesBucket const& pending = finer.pending;
+        if (end < pending.start)
+            break;
+        if (!(pending.end < start))
+            result.push_back(pendingBucket(finer));
+    }
+    return level_idx;
+}
+
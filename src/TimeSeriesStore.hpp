@@ -0,0 +1,142 @@
+#ifndef DVL_TELEDYNE_TIMESERIESSTORE_HPP
+#define DVL_TELEDYNE_TIMESERIESSTORE_HPP
+
+#include <dvl_teledyne/PD0Messages.hpp>
+#include <vector>
+
+namespace dvl_teledyne
+{
+    /** Quantities recorded by TimeSeriesStore */
+    enum TIMESERIES_CHANNELS
+    {
+        /** Mean of the known bottom tracking ranges, in meters */
+        CHANNEL_RANGE,
+        /** First three bottom tracking velocity components, in m/s */
+        CHANNEL_VELOCITY_X,
+        CHANNEL_VELOCITY_Y,
+        CHANNEL_VELOCITY_Z,
+        /** Mean of the bottom tracking correlations (between 0 and 1) */
+        CHANNEL_CORRELATION,
+        /** Temperature at the transducer, in degrees celsius */
+        CHANNEL_TEMPERATURE,
+        /** Depth of the transducer, in meters */
+        CHANNEL_DEPTH,
+        CHANNEL_COUNT
+    };
+
+    /** Aggregate of the samples received during a time interval
+     *
+     * At full resolution, a bucket contains a single sample
+     */
+    struct TimeSeriesBucket
+    {
+        /** Time of the first and last sample in the bucket */
+        base::Time start;
+        base::Time end;
+        /** Count of samples in the bucket */
+        uint32_t count;
+        /** Count of known values per channel. min, max and mean are NaN for
+         * the channels that have no known value
+         */
+        uint32_t valid[CHANNEL_COUNT];
+        float min[CHANNEL_COUNT];
+        float max[CHANNEL_COUNT];
+        float mean[CHANNEL_COUNT];
+    };
+
+    struct TimeSeriesConfiguration
+    {
+        /** Count of resolution levels. Level 0 is full resolution */
+        int level_count;
+        /** Count of buckets kept at each level */
+        size_t level_capacity;
+        /** Count of buckets of level N-1 aggregated in one bucket of level N */
+        int decimation;
+
+        TimeSeriesConfiguration();
+    };
+
+    /** Multi-resolution store for long-term monitoring of the DVL
+     *
+     * The most recent samples are kept at full resolution, and older data
+     * as min/max/mean pyramids at coarser resolutions. Each level is a ring
+     * buffer of fixed capacity, so the memory footprint does not depend on
+     * the length of the mission. Insertion is O(1) amortized.
+     */
+    class TimeSeriesStore
+    {
+    public:
+        TimeSeriesStore(TimeSeriesConfiguration const& conf = TimeSeriesConfiguration());
+
+        void clear();
+
+        /** Adds one sample. NaN values are ignored for the aggregates.
+         * Samples must be pushed in increasing time order
+         */
+        void push(base::Time const& time, float const* values);
+        /** Extracts the channels from an ensemble's bottom tracking and status
+         * and adds them at the status time
+         */
+        void push(BottomTracking const& tracking, Status const& status);
+
+        /** Returns the buckets that overlap [start, end] at the best
+         * resolution available
+         *
+         * The finest level whose history covers \c start is used. If
+         * \c max_points is non-zero, coarser levels are used until the count
+         * of buckets is at most max_points.
+         *
+         * The most recent samples are not in a complete bucket of that level
+         * yet. They are returned after its complete buckets, as partial
+         * buckets aggregated from the finer levels, so that the result always
+         * extends to the last pushed sample. There are at most as many partial
+         * buckets as the index of the level that got used, and they are not
+         * counted in \c max_points.
+         *
+         * Returns the level that got used
+         */
+        int query(base::Time const& start, base::Time const& end,
+                std::vector<TimeSeriesBucket>& result, size_t max_points = 0) const;
+
+        /** Time of the oldest sample available at the given level. Null if
+         * the level is empty
+         */
+        base::Time getOldestTime(int level) const;
+
+        TimeSeriesConfiguration const& getConfiguration() const;
+
+    private:
+        struct Level
+        {
+            std::vector<TimeSeriesBucket> buckets;
+            size_t first;
+            size_t size;
+            /** True once buckets started to be overwritten. Until then, the
+             * level contains all the data since the last clear()
+             */
+            bool wrapped;
+
+            /** Bucket being aggregated from the finer level */
+            TimeSeriesBucket pending;
+            double pending_sum[CHANNEL_COUNT];
+            int pending_children;
+        };
+
+        TimeSeriesConfiguration mConf;
+        std::vector<Level> mLevels;
+
+        static void resetPending(Level& level);
+        /** The pending bucket of \c level, with its means computed */
+        static TimeSeriesBucket pendingBucket(Level const& level);
+        void append(int level_idx, TimeSeriesBucket const& bucket);
+        void aggregate(int level_idx, TimeSeriesBucket const& bucket);
+        TimeSeriesBucket const& at(Level const& level, size_t i) const;
+        /** Index of the first bucket of the level whose end is not before
+         * \c time */
+        size_t lowerBound(Level const& level, base::Time const& time) const;
+        size_t countInRange(Level const& level, base::Time const& start, base::Time const& end) const;
+    };
+}
+
+#endif
+